@@ -1,614 +1,1397 @@
-# include <Siv3D.hpp>
+# if SINLAND_HEADLESS
+// シミュレーション部だけを Siv3D なしでビルドする（ウィンドウ・音・入力なし）
+//   g++ -std=c++20 -O2 -DSINLAND_HEADLESS -x c++ Main.cpp -o sinland_headless
+#	include <cstdint>
+#	include <cstdio>
+#	include <cstdlib>
+#	include <cstring>
+#	include <new>
+#	include <cmath>
+#	include <chrono>
+#	include <atomic>
+#	include <vector>
+#	include <unordered_map>
+#	include <algorithm>
+#	include <cstddef>
+#	include <memory>
+#	include <numeric>
+
+// シミュレーション部が使う Siv3D の値型・関数の最小限の代替（挙動は Siv3D に合わせる）
+namespace s3d {
+	using int32 = std::int32_t;
+	using int64 = std::int64_t;
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	namespace Math {
+		inline constexpr double Pi = 3.141592653589793;
+		inline constexpr double TwoPi = 6.283185307179586;
+		inline double Floor(double v) { return std::floor(v); }
+		inline double Ceil(double v) { return std::ceil(v); }
+		inline double Round(double v) { return std::round(v); }
+		inline double Sin(double v) { return std::sin(v); }
+		inline double Sqrt(double v) { return std::sqrt(v); }
+		inline double Abs(double v) { return std::abs(v); }
+		inline constexpr double Lerp(double a, double b, double t) { return a + (b - a) * t; }
+	}
 
-//============================= 共有データ =============================
-struct Shared {
-	int unlocked = 1;
-};
+	template <class T> constexpr T Max(T a, T b) { return (a < b) ? b : a; }
+	template <class T> constexpr T Min(T a, T b) { return (b < a) ? b : a; }
+	template <class T> constexpr T Clamp(T v, T lo, T hi) { return (v < lo) ? lo : ((hi < v) ? hi : v); }
+	template <class T> constexpr T Abs(T v) { return (v < 0) ? -v : v; }
+	constexpr double Saturate(double v) { return Clamp(v, 0.0, 1.0); }
 
-void StopAllAudio()
-{
-	AudioAsset(U"stage1BGM").stop();
-	AudioAsset(U"heartbeat").stop();
-	AudioAsset(U"monkeySE").stop();
-	AudioAsset(U"green2SE").stop();
-	AudioAsset(U"car3SE").stop();
-	AudioAsset(U"stageLastBGM").stop();
-}
+	inline namespace Literals {
+		constexpr double operator""_deg(unsigned long long deg) { return deg * (Math::Pi / 180.0); }
+		constexpr double operator""_deg(long double deg) { return (double)deg * (Math::Pi / 180.0); }
+	}
 
-//============================= プレイヤー =============================
-struct Player {
-	Size  size{ 28, 36 };
-	Vec2  pos{ 120, 540 };
-	Vec2  prevPos{ 120, 540 };
-	Vec2  vel{ 0, 0 };
-	bool  grounded = false;
-	bool  jumpedThisFrame = false;
-	double walkPhase = 0.0;
+	struct Point {
+		int32 x = 0, y = 0;
+		constexpr Point() = default;
+		constexpr Point(int32 _x, int32 _y) : x{ _x }, y{ _y } {}
+	};
+	using Size = Point;
+
+	struct Vec2 {
+		double x = 0.0, y = 0.0;
+		constexpr Vec2() = default;
+		constexpr Vec2(double _x, double _y) : x{ _x }, y{ _y } {}
+		constexpr Vec2 operator +(const Vec2& v) const { return{ x + v.x, y + v.y }; }
+		constexpr Vec2 operator -(const Vec2& v) const { return{ x - v.x, y - v.y }; }
+		constexpr Vec2 operator *(double s) const { return{ x * s, y * s }; }
+		constexpr Vec2& operator +=(const Vec2& v) { x += v.x; y += v.y; return *this; }
+		constexpr bool operator ==(const Vec2&) const = default;
+		constexpr Vec2 movedBy(double dx, double dy) const { return{ x + dx, y + dy }; }
+		constexpr Vec2 lerp(const Vec2& to, double t) const { return{ x + (to.x - x) * t, y + (to.y - y) * t }; }
+	};
 
-	double gravity = 1800.0;
-	double moveAccel = 2400.0;
-	double airAccel = 1400.0;
-	double maxSpeedX = 260.0;
-	double jumpSpeed = 560.0;
-	double groundFric = 14.0;
-	double airFric = 2.0;
+	struct RectF {
+		double x = 0.0, y = 0.0, w = 0.0, h = 0.0;
+		constexpr RectF() = default;
+		constexpr RectF(double _x, double _y, double _w, double _h) : x{ _x }, y{ _y }, w{ _w }, h{ _h } {}
+		constexpr RectF(const Vec2& p, const Size& s) : x{ p.x }, y{ p.y }, w{ (double)s.x }, h{ (double)s.y } {}
+		constexpr RectF(const Vec2& p, double _w, double _h) : x{ p.x }, y{ p.y }, w{ _w }, h{ _h } {}
+		constexpr bool operator ==(const RectF&) const = default;
+		constexpr bool intersects(const RectF& r) const {
+			return (x < r.x + r.w) && (r.x < x + w) && (y < r.y + r.h) && (r.y < y + h);
+		}
+		constexpr RectF& setPos(const Vec2& p) { x = p.x; y = p.y; return *this; }
+		constexpr RectF stretched(double d) const { return{ x - d, y - d, w + d * 2, h + d * 2 }; }
+		constexpr RectF stretched(double dx, double dy) const { return{ x - dx, y - dy, w + dx * 2, h + dy * 2 }; }
+		constexpr double centerX() const { return x + w * 0.5; }
+		constexpr double centerY() const { return y + h * 0.5; }
+		constexpr Vec2 center() const { return{ centerX(), centerY() }; }
+	};
 
-	bool update(const Array<RectF>& colliders) {
-		prevPos = pos;
-		jumpedThisFrame = false;
-		const bool left = (KeyA.pressed() || KeyLeft.pressed());
-		const bool right = (KeyD.pressed() || KeyRight.pressed());
-		const bool jumpPressed = (KeySpace.down() || KeyW.down() || KeyUp.down());
-		const bool running = KeyShift.pressed();
+	template <class T>
+	struct Array : std::vector<T> {
+		using std::vector<T>::vector;
+		Array& operator <<(const T& v) { this->push_back(v); return *this; }
+		bool isEmpty() const { return this->empty(); }
+	};
 
-		double ax = 0.0;
-		if (left ^ right) {
-			const double a = grounded ? moveAccel : airAccel;
-			ax = (left ? -a : a);
+	template <class K, class V>
+	using HashTable = std::unordered_map<K, V>;
+}
+using namespace s3d;
+# else
+#	include <Siv3D.hpp>
+#	include <cstdio>
+#	include <atomic>
+#	include <thread>
+#	if SIV3D_PLATFORM(WINDOWS)
+#		define NOMINMAX
+#		include <Windows.h>
+#		include <Psapi.h>
+#		include <timeapi.h>
+#		pragma comment(lib, "winmm")
+#	else
+#		include <sys/resource.h>
+#	endif
+# endif
+
+# if !SINLAND_HEADLESS
+//============================= 曲線の折れ線キャッシュ =============================
+// Bezier2 を折れ線にした結果を、始点から見た制御点（p1 - p0, p2 - p0）ごとに覚えておく。
+// 平行移動しかしない曲線は、2回目からは表を引いて始点を足すだけで描ける。
+// 表が埋まったら一番長く使われていないものを捨てる
+class BezierCache {
+public:
+	// F3 の表示用（フレームごとに DrawRenderStats が読んで 0 に戻す）
+	static inline size_t FrameHits = 0;
+	static inline size_t FrameMisses = 0;
+
+	static void Draw(const Bezier2& b, double thickness, const ColorF& color) {
+		const Optional<uint64> key = MakeKey(b.p1 - b.p0, b.p2 - b.p0);
+		if (!key) {
+			b.draw(thickness, color);   // 大きすぎてキーに収まらない曲線はそのまま
+			return;
 		}
-		const double maxX = running ? (maxSpeedX * 1.4) : maxSpeedX;
-		const double dt = Scene::DeltaTime();
 
-		vel.x += ax * dt;
-		vel.x -= vel.x * Min((grounded ? groundFric : airFric) * dt, 1.0);
-		vel.x = Clamp(vel.x, -maxX, maxX);
+		const LineString& local = find(*key, b);
+		moved.resize(local.size());
+		for (size_t i = 0; i < local.size(); ++i) moved[i] = local[i] + b.p0;
+		moved.draw(thickness, color);
+	}
 
-		vel.y += gravity * dt;
+	static size_t Size() { return entries.size(); }
 
-		if (grounded && jumpPressed) {
-			vel.y = -jumpSpeed;
-			grounded = false;
-			jumpedThisFrame = true;
-		}
+private:
+	static constexpr size_t Capacity = 64;
+	static constexpr double Quantum = 64.0;   // 1/64px 単位で同じ曲線とみなす
 
-		// X 衝突
-		pos.x += vel.x * dt;
-		RectF aabbX{ pos, size };
-		for (const auto& c : colliders) {
-			if (!aabbX.intersects(c)) continue;
-			if (vel.x > 0) pos.x = c.x - size.x - 0.01;
-			else if (vel.x < 0) pos.x = c.x + c.w + 0.01;
-			vel.x = 0;
-			aabbX.setPos(pos);
-		}
-		// Y 衝突
-		pos.y += vel.y * dt;
-		RectF aabbY{ pos, size };
-		grounded = false;
-		for (const auto& c : colliders) {
-			if (!aabbY.intersects(c)) continue;
-			if (vel.y > 0) { pos.y = c.y - size.y - 0.01; vel.y = 0; grounded = true; }
-			else if (vel.y < 0) { pos.y = c.y + c.h + 0.01; vel.y = 0; }
-			aabbY.setPos(pos);
+	struct Entry {
+		LineString local;   // 始点を原点にした折れ線
+		uint64     lastUse = 0;
+	};
+
+	static inline HashTable<uint64, Entry> entries;
+	static inline uint64 clock = 0;
+	static inline LineString moved;   // 描画用の作業領域（容量を使い回す）
+
+	// 制御点を 16bit ずつ詰める（±512px を超えるものは扱わない）
+	static Optional<uint64> MakeKey(const Vec2& d1, const Vec2& d2) {
+		uint64 key = 0;
+		for (const double v : { d1.x, d1.y, d2.x, d2.y }) {
+			const double q = Math::Round(v * Quantum);
+			if (q < -32768.0 || 32767.0 < q) return none;
+			key = (key << 16) | (uint16)(int16)q;
 		}
-		return true;
+		return key;
 	}
 
-	void advanceAnim() {
-		const bool isMovingHoriz = (Math::Abs(vel.x) > 1.0);
-		if (isMovingHoriz && grounded) {
-			walkPhase += Scene::DeltaTime() * Math::TwoPi * (8.0 / 2.0);
+	static const LineString& find(uint64 key, const Bezier2& b) {
+		++clock;
+		if (auto it = entries.find(key); it != entries.end()) {
+			++FrameHits;
+			it->second.lastUse = clock;
+			return it->second.local;
 		}
-	}
 
-	void draw() const {
-		const bool isMovingHoriz = (Math::Abs(vel.x) > 1.0);
+		++FrameMisses;
+		if (Capacity <= entries.size()) {
+			auto oldest = entries.begin();
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+			}
+			entries.erase(oldest);
+		}
+		const Bezier2 local{ Vec2{ 0, 0 }, b.p1 - b.p0, b.p2 - b.p0 };
+		return entries.emplace(key, Entry{ local.getLineString(), clock }).first->second.local;
+	}
+};
 
-		Circle{ pos + Vec2{ size.x * 0.5, size.y + 6 }, 12 }
-		.draw(ColorF{ 0, 0, 0, grounded ? 0.18 : 0.10 });
+//============================= 描画リスト =============================
+// 図形を1フレーム分レイヤーごとに溜め、submit でレイヤー順に流す。
+// Siv3D は同じ状態の図形を1つの頂点バッチにまとめるが、文字（フォントのテクスチャ）や
+// Transformer2D を挟むとそこでバッチが切れる。ここでは
+//   ・同じ変換が続く図形は Transformer2D を1回だけ張る
+//   ・文字はレイヤー内の図形をすべて出したあとにまとめて出す
+// ことで、レイヤーあたりのバッチを図形1＋文字1に寄せる
+enum class DrawLayer : uint8 { World, UI, Count };
 
-		const Vec2 center = pos + Vec2{ size } / 2;
-		const double step = grounded ? (6.0 * Math::Sin(walkPhase * 2.0) * (isMovingHoriz ? 1.0 : 0.0)) : 0.0;
-		const double swing = (isMovingHoriz && grounded) ? (12.0 * Math::Sin(walkPhase)) : 0.0;
-		const double tilt = (isMovingHoriz ? Clamp(vel.x / maxSpeedX, -1.0, 1.0) * 0.12 : 0.0);
+class DrawList {
+public:
+	// F3 の表示用（submit のたびに積算、DrawRenderStats がフレームごとに読んで 0 に戻す）
+	static inline size_t FramePrims = 0;
+	static inline size_t FrameRuns = 0;
 
-		const RoundRect body{ RectF{ Arg::center = center.movedBy(0, -4 + step), size }, 6.0 };
-		const Transformer2D t{ Mat3x2::Rotate(tilt, body.rect.center()) };
-		body.draw(ColorF{ 0.1, 0.1, 0.12 });
+	void setLayer(DrawLayer l) { layer = l; }
 
-		const Circle head{ center.movedBy(0, -size.y * 0.9 + step), 14 };
-		head.draw(ColorF{ 0.95 });
+	// 以降の図形にかける変換（identity で解除）
+	void setTransform(const Mat3x2& m) {
+		transforms << m;
+		transform = (uint16)(transforms.size() - 1);
+	}
+	void resetTransform() { transform = 0; }
+
+	void add(const RectF& r, const ColorF& c)     { push(Kind::Rect, c, { r.x, r.y, r.w, r.h }); }
+	void add(const RoundRect& r, const ColorF& c) { push(Kind::RoundRect, c, { r.rect.x, r.rect.y, r.rect.w, r.rect.h, r.r }); }
+	void add(const Circle& s, const ColorF& c)    { push(Kind::Circle, c, { s.center.x, s.center.y, s.r }); }
+	void add(const Ellipse& e, const ColorF& c)   { push(Kind::Ellipse, c, { e.center.x, e.center.y, e.a, e.b }); }
+	void add(const Quad& q, const ColorF& c)      { push(Kind::Quad, c, { q.p0.x, q.p0.y, q.p1.x, q.p1.y, q.p2.x, q.p2.y, q.p3.x, q.p3.y }); }
+	void add(const Triangle& t, const ColorF& c)  { push(Kind::Triangle, c, { t.p0.x, t.p0.y, t.p1.x, t.p1.y, t.p2.x, t.p2.y }); }
+	void add(const Line& l, double thickness, const ColorF& c) {
+		push(Kind::Line, c, { l.begin.x, l.begin.y, l.end.x, l.end.y, thickness });
+	}
+	void add(const Bezier2& b, double thickness, const ColorF& c) {
+		push(Kind::Bezier, c, { b.p0.x, b.p0.y, b.p1.x, b.p1.y, b.p2.x, b.p2.y, thickness });
+	}
+	void addFrame(const RectF& r, double inner, double outer, const ColorF& c) {
+		push(Kind::Frame, c, { r.x, r.y, r.w, r.h, inner, outer });
+	}
 
-		const Vec2 faceDir = (Math::Abs(vel.x) > Math::Abs(vel.y))
-			? Vec2{ (vel.x >= 0 ? 1 : -1), 0 }
-		: Vec2{ 0, (vel.y >= 0 ? 1 : -1) };
-		const Vec2 eyeOffset = faceDir * Vec2{ 4, 3 } *0.5;
-		Circle{ head.center.movedBy(-5, -2) + eyeOffset, 1.6 }.draw(ColorF{ 0.08 });
-		Circle{ head.center.movedBy(5, -2) + eyeOffset, 1.6 }.draw(ColorF{ 0.08 });
+	// テクスチャの一部。左上を pos に置き、左上から見た pivot のまわりに angle 回す
+	void addSprite(const TextureRegion& region, const Vec2& pos, double angle, const Vec2& pivot, const ColorF& c) {
+		if (sprites.size() <= spriteCount) sprites.emplace_back();
+		sprites[spriteCount] = region;
+		push(Kind::Sprite, c, { pos.x, pos.y, angle, pivot.x, pivot.y, (double)spriteCount });
+		++spriteCount;
+	}
 
-		const Vec2 armBaseL = body.rect.center().movedBy(-size.x * 0.6, -size.y * 0.2 + step);
-		const Vec2 armBaseR = body.rect.center().movedBy(size.x * 0.6, -size.y * 0.2 + step);
-		Line{ armBaseL, armBaseL.movedBy(0, 14 + swing * 0.2) }.draw(4, ColorF{ 0.15 });
-		Line{ armBaseR, armBaseR.movedBy(0, 14 - swing * 0.2) }.draw(4, ColorF{ 0.15 });
+	// 中央揃えの文字
+	void addTextAt(const Font& font, const String& text, const Vec2& center, const ColorF& c) {
+		if (texts.size() <= textCount) texts.emplace_back();
+		TextItem& t = texts[textCount];
+		t.font = font;     // ハンドルのコピー（参照カウントが増えるだけ）
+		t.text = text;   // 前フレームの容量を使い回す
+		push(Kind::Text, c, { center.x, center.y, (double)textCount });
+		++textCount;
+	}
 
-		const Vec2 footBase = body.rect.center().movedBy(0, size.y * 0.5 + step);
-		const Vec2 footL = footBase.movedBy(-8 - swing, 8);
-		const Vec2 footR = footBase.movedBy(8 + swing, 8);
-		Line{ footBase.movedBy(-6, -4), footL }.draw(5, ColorF{ 0.12 });
-		Line{ footBase.movedBy(6, -4), footR }.draw(5, ColorF{ 0.12 });
-		Circle{ footL, 4 }.draw(ColorF{ 0.2 });
-		Circle{ footR, 4 }.draw(ColorF{ 0.2 });
+	// レイヤー順に描いて空にする
+	void submit() {
+		for (int32 l = 0; l < (int32)DrawLayer::Count; ++l) {
+			submitShapes((DrawLayer)l);
+			submitTexts((DrawLayer)l);
+		}
+		FramePrims += prims.size();
+		prims.clear();
+		transforms.resize(1);
+		transform = 0;
+		textCount = 0;
+		spriteCount = 0;
 	}
-};
 
-//============================= UI =============================
-struct UIButton {
-	RectF  rect;
-	String text;
+private:
+	enum class Kind : uint8 { Rect, RoundRect, Circle, Ellipse, Quad, Triangle, Line, Bezier, Frame, Sprite, Text };
+
+	struct Prim {
+		Kind      kind;
+		DrawLayer layer;
+		uint16    transform;
+		ColorF    color;
+		double    v[8];
+	};
 
-	double hoverDarken = 0.12;
-	double pressInset = 2.0;
+	struct TextItem {
+		Font   font;
+		String text;
+	};
 
-	mutable bool wasHovered = false;
-	bool enabled = true;
+	Array<Prim>     prims;
+	Array<Mat3x2>   transforms{ Mat3x2::Identity() };
+	Array<TextItem> texts;
+	Array<TextureRegion> sprites;
+	size_t    textCount = 0;
+	size_t    spriteCount = 0;
+	DrawLayer layer = DrawLayer::World;
+	uint16    transform = 0;
+
+	void push(Kind kind, const ColorF& c, std::initializer_list<double> v) {
+		Prim p{ kind, layer, transform, c, {} };
+		std::copy(v.begin(), v.end(), p.v);
+		prims << p;
+	}
 
-	UIButton(const RectF& r, StringView t) : rect{ r }, text{ t } {}
+	void submitShapes(DrawLayer l) {
+		Optional<Transformer2D> tf;
+		int32 current = -1;
+		for (const auto& p : prims) {
+			if ((p.layer != l) || (p.kind == Kind::Text)) continue;
+			if (p.transform != current) {
+				tf.reset();
+				if (p.transform != 0) tf.emplace(transforms[p.transform]);
+				current = p.transform;
+				++FrameRuns;
+			}
+			const double* v = p.v;
+			switch (p.kind) {
+			case Kind::Rect:      RectF{ v[0], v[1], v[2], v[3] }.draw(p.color); break;
+			case Kind::RoundRect: RoundRect{ v[0], v[1], v[2], v[3], v[4] }.draw(p.color); break;
+			case Kind::Circle:    Circle{ v[0], v[1], v[2] }.draw(p.color); break;
+			case Kind::Ellipse:   Ellipse{ v[0], v[1], v[2], v[3] }.draw(p.color); break;
+			case Kind::Quad:      Quad{ Vec2{ v[0], v[1] }, Vec2{ v[2], v[3] }, Vec2{ v[4], v[5] }, Vec2{ v[6], v[7] } }.draw(p.color); break;
+			case Kind::Triangle:  Triangle{ Vec2{ v[0], v[1] }, Vec2{ v[2], v[3] }, Vec2{ v[4], v[5] } }.draw(p.color); break;
+			case Kind::Line:      Line{ v[0], v[1], v[2], v[3] }.draw(v[4], p.color); break;
+			case Kind::Bezier:    BezierCache::Draw(Bezier2{ Vec2{ v[0], v[1] }, Vec2{ v[2], v[3] }, Vec2{ v[4], v[5] } }, v[6], p.color); break;
+			case Kind::Frame:     RectF{ v[0], v[1], v[2], v[3] }.drawFrame(v[4], v[5], p.color); break;
+			case Kind::Sprite:    sprites[(size_t)v[5]].rotatedAt(Vec2{ v[3], v[4] }, v[2]).draw(v[0], v[1], p.color); break;
+			case Kind::Text:      break;
+			}
+		}
+	}
 
-	// --- 入力なしの描画だけ ---
-	void draw(const Font& font) const {
-		const bool hovered = enabled && rect.mouseOver();
-		const bool pressing = hovered && MouseL.pressed();
+	void submitTexts(DrawLayer l) {
+		Optional<Transformer2D> tf;
+		int32 current = -1;
+		for (const auto& p : prims) {
+			if ((p.layer != l) || (p.kind != Kind::Text)) continue;
+			if (p.transform != current) {
+				tf.reset();
+				if (p.transform != 0) tf.emplace(transforms[p.transform]);
+				current = p.transform;
+				++FrameRuns;
+			}
+			const TextItem& t = texts[(size_t)p.v[2]];
+			t.font(t.text).drawAt(Vec2{ p.v[0], p.v[1] }, p.color);
+		}
+	}
+};
 
-		const ColorF base = enabled ? ColorF{ 1.0 } : ColorF{ 0.92 };
-		const ColorF frame = enabled ? ColorF{ 0.2 } : ColorF{ 0.7 };
-		const ColorF textCol = enabled ? ColorF{ 0.1 } : ColorF{ 0.6 };
+//============================= スプライトアトラス =============================
+// 図形を組み合わせて描いているキャラや小物を、決まったコマ（ポーズ・歩きの位相）ごとに
+// 1枚のテクスチャへ焼いておき、実行中は1コマ＝1枚の四角形で描く。
+// 図形の記録とコマの配置はワーカースレッドで行い、GPU を使う描き込みだけメインスレッドで行う
+enum class Sprite : uint8 { Player, MonkeyWalk, MonkeySit, Fruit, Car, Door, Count };
 
-		rect.draw(base);
-		if (enabled && hovered) { rect.draw(ColorF{ 0,0,0, hoverDarken }); }
-		if (enabled && pressing) { rect.stretched(-pressInset).draw(ColorF{ 0,0,0, 0.10 }); }
-		rect.drawFrame(2, 0, frame);
-		font(text).drawAt(rect.center(), textCol);
+class SpriteAtlas {
+public:
+	struct Figure {
+		Sprite id;
+		String name;
+		Size   cell;      // 1コマの大きさ
+		Vec2   origin;    // コマ内の基準点
+		int32  frames;
+		std::function<void(DrawList&, int32)> paint;   // 基準点を (0, 0) として frame 番目を描く
+		Array<Size> frameCells;   // コマごとに大きさが違うとき（空なら全コマ cell）
+	};
+
+	struct Report {
+		String name;
+		int32  frames;
+		double recordMs;  // ワーカーで図形を記録した時間
+		double rasterMs;  // メインスレッドでアトラスに描き込んだ時間
+	};
+
+	// 焼き始める（2回目以降は何もしない）
+	static void Begin(Array<Figure> figures) {
+		if (task.isValid() || texture) return;
+		task = Async(Record, std::move(figures));
 	}
 
-	bool drawAndCheck(const Font& font) const {
-		const bool hovered = enabled && rect.mouseOver();
-		const bool pressing = hovered && MouseL.pressed();
-		const bool clicked = hovered && MouseL.down();
+	// 毎フレーム呼ぶ。記録が終わっていればアトラスに描き込む
+	static void Update() {
+		if (!task.isValid() || !task.isReady()) return;
 
-		const ColorF base = enabled ? ColorF{ 1.0 } : ColorF{ 0.92 };
-		const ColorF frame = enabled ? ColorF{ 0.2 } : ColorF{ 0.7 };
-		const ColorF textCol = enabled ? ColorF{ 0.1 } : ColorF{ 0.6 };
+		Recorded rec = task.get();
+		texture = RenderTexture{ rec.size, ColorF{ 0.0, 0.0 } };
+		{
+			const ScopedRenderTarget2D target{ texture };
+			const ScopedRenderStates2D blend{ KeepAlphaBlend() };
+			for (size_t i = 0; i < rec.lists.size(); ++i) {
+				const Stopwatch sw{ StartImmediately::Yes };
+				rec.lists[i].submit();
+				Graphics2D::Flush();
+				rec.reports[i].rasterMs = sw.msF();
+			}
+		}
+		slots = std::move(rec.slots);
+		first = rec.first;
+		counts = rec.counts;
+		reports = std::move(rec.reports);
 
-		rect.draw(base);
-		if (enabled && hovered) { rect.draw(ColorF{ 0,0,0, hoverDarken }); }
-		if (enabled && pressing) { rect.stretched(-pressInset).draw(ColorF{ 0,0,0, 0.10 }); }
-		rect.drawFrame(2, 0, frame);
-		font(text).drawAt(rect.center(), textCol);
+		for (const auto& r : reports) {
+			Logger << U"atlas: {} x{}  record {:.2f} ms / raster {:.2f} ms"_fmt(r.name, r.frames, r.recordMs, r.rasterMs);
+		}
+		Logger << U"atlas: {}x{}  {} KB"_fmt(rec.size.x, rec.size.y, MemoryBytes() / 1024);
+	}
 
-		// SE
-		if (hovered && !wasHovered)
-			AudioAsset(U"UIselectSE").play();
-		if (clicked)
-			AudioAsset(U"UIenterSE").play();
+	static bool Ready() { return (bool)texture; }
 
-		wasHovered = hovered;
-		return (enabled && clicked);
+	// id の frame 番目を、基準点が pos に来るよう積む（焼き上がる前は false：呼び出し側で図形を描く）
+	// scale はコマの拡大率、pivot は基準点から見た回転の中心
+	static bool Add(DrawList& list, Sprite id, int32 frame, const Vec2& pos,
+		const Vec2& scale = Vec2{ 1, 1 }, double angle = 0.0, const Vec2& pivot = Vec2{ 0, 0 }) {
+		if (!texture || frame < 0 || counts[(size_t)id] <= (uint32)frame) return false;
+		const Slot& s = slots[first[(size_t)id] + frame];
+		const Vec2 o = s.origin * scale;
+		list.addSprite(texture(s.rect).resized(s.rect.w * scale.x, s.rect.h * scale.y), pos - o, angle, o + pivot, ColorF{ 1.0 });
+		return true;
 	}
-};
 
-//============================= シーン管理 =============================
-enum class State { Title, Select, Stage1, Stage2, Stage3, Stage4, StageLast, EndRoll };
-using App = SceneManager<State, Shared>;
+	static size_t MemoryBytes() {
+		if (!texture) return 0;
+		const Size sz = texture.size();
+		return (size_t)sz.x * sz.y * 4;
+	}
 
-static Array<RectF> MakeLevelColliders(const Size sceneSize, const Array<RectF>& platforms) {
-	Array<RectF> cols = platforms;
-	cols << RectF{ -100, 0, 100, (double)sceneSize.y };
-	cols << RectF{ (double)sceneSize.x, 0, 100, (double)sceneSize.y };
-	return cols;
-}
-static void DrawGoal(const RectF& goal) {
-	goal.draw(ColorF{ 0.75, 0.94, 0.80 });
-	goal.drawFrame(2, 0, ColorF{ 0.15, 0.45, 0.2 });
-	Triangle{ goal.pos.movedBy(10, -20), goal.pos.movedBy(10, 0), goal.pos.movedBy(38, -10) }
-	.draw(ColorF{ 0.2, 0.7, 0.3 });
-	Line{ goal.pos.movedBy(10, -24), goal.pos.movedBy(10, 2) }.draw(3, ColorF{ 0.2, 0.2, 0.2 });
-}
+	static double TotalMs() {
+		double ms = 0.0;
+		for (const auto& r : reports) ms += (r.recordMs + r.rasterMs);
+		return ms;
+	}
 
-//----------------------------- Title -----------------------------
-class Title : public App::Scene {
-	Font title{ 80, Typeface::Light }, font{ 18 };
-	UIButton start{ RectF{ Arg::center = Scene::Center().movedBy(0, 40), 220, 48 }, U"スタート" };
-	UIButton select{ RectF{ Arg::center = Scene::Center().movedBy(0, 100), 220, 48 }, U"ステージセレクト" };
+private:
+	static constexpr int32 AtlasWidth = 1024;
+	static constexpr int32 Padding = 2;   // 隣のコマが縁ににじまないように空ける
 
-	struct Ring {
-		Vec2 pos; double r, alpha, shrink;
-		Ring(Vec2 p) : pos{ p }, r{ Random(280.0, 420.0) }, alpha{ 0.35 }, shrink{ Random(0.985, 0.992) } {}
-		bool update() { r *= shrink; alpha *= 0.97; return (alpha > 0.02); }
-		void draw() const { Circle(pos, r).drawFrame(r * 0.25, ColorF{ 0.5, 0.5, 0.5, alpha }); }
+	struct Slot {
+		RectF rect;
+		Vec2  origin;
 	};
 
-	Array<Ring> rings;
-	Stopwatch spawn{ StartImmediately::Yes };
+	using Index = std::array<uint32, (size_t)Sprite::Count>;
 
-	bool   fading = false;
-	Stopwatch fadeSW{ StartImmediately::No };
-	double fadeOutSec = 0.6;
+	struct Recorded {
+		Array<DrawList> lists;    // 図柄ごと
+		Array<Slot>     slots;
+		Index first{}, counts{};
+		Size  size{ 0, 0 };
+		Array<Report> reports;
+	};
 
-	// === キーボード選択 ===
-	int focus = -1; // -1: 解除 / 0: start / 1: select
+	static inline AsyncTask<Recorded> task;
+	static inline RenderTexture texture;
+	static inline Array<Slot> slots;
+	static inline Index first{}, counts{};
+	static inline Array<Report> reports;
+
+	// 左上から横に並べ、幅を超えたら次の段へ
+	static Recorded Record(Array<Figure> figures) {
+		Recorded rec;
+		Point cursor{ Padding, Padding };
+		int32 rowHeight = 0;
+
+		for (const auto& f : figures) {
+			const Stopwatch sw{ StartImmediately::Yes };
+			DrawList list;
+			rec.first[(size_t)f.id] = (uint32)rec.slots.size();
+			rec.counts[(size_t)f.id] = (uint32)f.frames;
+
+			for (int32 i = 0; i < f.frames; ++i) {
+				const Size cell = f.frameCells.isEmpty() ? f.cell : f.frameCells[i];
+				if (AtlasWidth < cursor.x + cell.x + Padding) {
+					cursor = Point{ Padding, cursor.y + rowHeight + Padding };
+					rowHeight = 0;
+				}
+				list.setTransform(Mat3x2::Translate(Vec2{ cursor } + f.origin));
+				f.paint(list, i);
+				rec.slots << Slot{ RectF{ Vec2{ cursor }, Vec2{ cell } }, f.origin };
+				cursor.x += (cell.x + Padding);
+				rowHeight = Max(rowHeight, cell.y);
+			}
+			list.resetTransform();
 
-	void drawFocusOverlay(const RectF& r) const {
-		r.draw(ColorF{ 0,0,0, 0.12 });
-		r.stretched(-2).draw(ColorF{ 0,0,0, 0.06 });
-		r.drawFrame(2, 0, ColorF{ 0,0,0, 0.15 });
+			rec.lists << std::move(list);
+			rec.reports << Report{ f.name, f.frames, sw.msF(), 0.0 };
+		}
+		rec.size = Size{ AtlasWidth, cursor.y + rowHeight + Padding };
+		return rec;
 	}
 
-public:
-	Title(const InitData& init) : IScene{ init } {
-		AudioAsset::Register(U"UIenterSE", U"Assets/UIenterSE.mp3");
-		AudioAsset(U"UIenterSE").setVolume(0.5);
-		AudioAsset::Register(U"UIselectSE", U"Assets/UIselectSE.mp3");
+	// 透明な下地に描くため、アルファは足し込まず大きい方を残す
+	static BlendState KeepAlphaBlend() {
+		BlendState b = BlendState::Default2D;
+		b.srcAlpha = Blend::SrcAlpha;
+		b.dstAlpha = Blend::DestAlpha;
+		b.opAlpha = BlendOp::Max;
+		return b;
 	}
+};
+# endif
+
+//============================= シミュレーション =============================
+// ここから「ステージ共通」までは Siv3D の描画・音・入力・時計に依存しない。
+// 入力スナップショットと dt で進め、音やクリアはイベントとして外に出す
+
+//============================= 入力 =============================
+// 1tick 分の操作（実機ではキーをフレームごとに1回だけ読んで作る）
+struct PlayerInput {
+	bool left = false;
+	bool right = false;
+	bool jump = false;   // 押した瞬間（押した時刻を含む tick で消費）
+	bool run = false;
+	uint8 jumpSub = 0;   // 押した時刻：この tick の始まりから 1/16 tick 単位（0..15）
+};
 
-	void update() override {
-		// 背景
-		if (spawn.sF() >= 1.5) { rings << Ring{ Vec2{ Random(0.0, (double)Scene::Width()), Random(0.0, (double)Scene::Height()) } }; spawn.restart(); }
-		for (auto& g : rings) g.update();
-		rings.remove_if([](const Ring& g) { return g.alpha <= 0.02; });
-		Scene::SetBackground(ColorF{ 0.96, 0.98, 1.0 });
+//============================= イベント =============================
+// tick 中に起きた音・進行の合図。再生やシーン遷移は受け取った側が行う
+enum class SimEvent : uint8 {
+	PlayMonkey, PlayButton, PlayDoor, PlayClear, StopStage1BGM,
+	StartHeartbeat, StopHeartbeat,   // 鼓動は拍ごとではなく、開始・停止だけを知らせる
+	PlayPush, PlayBreak,
+	PlayGreen, PlayCarApproach, PlayCarHit, PlayCarHit2, StopStage4BGM,
+	PlayClick, StopStageLastBGM,
+	StopAllAudio,
+	Cleared,
+};
 
-		// === マウスホバーがあればキーボード選択を解除 ===
-		const bool anyHover = (start.rect.mouseOver() || select.rect.mouseOver());
-		if (anyHover) focus = -1;
+//============================= 乱数 =============================
+// シード固定で再現できる乱数（splitmix64）。プラットフォームで結果が変わらないよう自前で持つ
+struct SimRng {
+	uint64 state = 0;
 
-		// === キー操作 ===
-		if (!fading) {
-			auto ensureFocus = [&]() { if (focus == -1) focus = 0; }; // 解除中に矢印で復帰したらStartへ
+	explicit SimRng(uint64 seed = 0) : state{ seed } {}
 
-			int prev = focus;
-			if (KeyLeft.down() || KeyUp.down()) { ensureFocus(); focus = Max(0, focus - 1); }
-			if (KeyRight.down() || KeyDown.down()) { ensureFocus(); focus = Min(1, focus + 1); }
-			if (focus != prev && focus != -1) AudioAsset(U"UIselectSE").play();
+	uint64 next() {
+		uint64 z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	double uniform(double a, double b) {
+		return a + (b - a) * ((next() >> 11) * (1.0 / 9007199254740992.0));
+	}
+	template <class T>
+	void shuffle(Array<T>& v) {
+		for (size_t i = v.size(); i > 1; --i) std::swap(v[i - 1], v[next() % i]);
+	}
+};
 
-			if ((KeyEnter.down() || KeyK.down() || KeySpace.down()) && focus != -1) {
-				AudioAsset(U"UIenterSE").play();
-				if (focus == 0) { fading = true; fadeSW.restart(); }
-				else { StopAllAudio(); changeScene(State::Select, 0.3s); }
-			}
-		}
+//============================= 一時メモリ =============================
+// tick の中だけで使う作業領域。先頭から詰めて確保し、tick の頭で reset して丸ごと捨てる。
+// 個別の解放はしない（溢れた分だけ通常のヒープに回し、解放もそちらで行う）
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity = 16 * 1024) : buffer(capacity) {}
 
-		// 既存マウス
-		if (!fading) {
-			if (start.drawAndCheck(font)) { fading = true; fadeSW.restart(); }
-			if (select.drawAndCheck(font)) { StopAllAudio(); changeScene(State::Select, 0.3s); }
-		}
-		else {
-			if (fadeSW.sF() >= fadeOutSec) {
-				StopAllAudio();
-				changeScene(State::Stage1, 0.0s);
-			}
-		}
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator =(const FrameArena&) = delete;
 
-		if (KeyEscape.down()) { System::Exit(); }
+	void* allocate(size_t bytes, size_t align) {
+		const size_t at = (used + (align - 1)) & ~(align - 1);
+		if (at + bytes > buffer.size()) {
+			++overflows;
+			return ::operator new(bytes);
+		}
+		used = at + bytes;
+		peak = Max(peak, used);
+		return buffer.data() + at;
 	}
 
-	void draw() const override {
-		for (const auto& g : rings) g.draw();
-		title(U"シン・ランド").drawAt(Scene::Center().movedBy(0, -60), ColorF{ 0.1 });
+	void deallocate(void* p) {
+		if (!owns(p)) ::operator delete(p);
+	}
 
-		start.draw(font);
-		select.draw(font);
+	void reset() { used = 0; }
 
-		if (!fading && focus != -1) {
-			drawFocusOverlay((focus == 0) ? start.rect : select.rect);
-		}
+	size_t bytesUsed() const { return used; }
+	size_t bytesPeak() const { return peak; }
+	size_t overflowCount() const { return overflows; }
 
-		if (fading) {
-			const double a = Clamp(fadeSW.sF() / fadeOutSec, 0.0, 1.0);
-			RectF(Scene::Rect()).draw(ColorF{ 0, 0, 0, a });
-		}
+private:
+	std::vector<unsigned char> buffer;
+	size_t used = 0;
+	size_t peak = 0;
+	size_t overflows = 0;
+
+	bool owns(const void* p) const {
+		const auto* c = static_cast<const unsigned char*>(p);
+		return (buffer.data() <= c) && (c < buffer.data() + buffer.size());
 	}
 };
 
+// FrameArena から取る標準アロケータ
+template <class T>
+struct ArenaAllocator {
+	using value_type = T;
 
-//----------------------------- Select -----------------------------
-class Select : public App::Scene {
-	Font font{ 18 };
+	FrameArena* arena = nullptr;
 
-	struct StageEntry { String name; bool available; Optional<State> target; };
-	Array<StageEntry> entries;
-	Array<UIButton>   buttons;
+	explicit ArenaAllocator(FrameArena& a) : arena{ &a } {}
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena{ other.arena } {}
 
-	UIButton deleteBtn{ RectF{ 20, 20, 120, 34 }, U"データ削除" };
-	UIButton backBtn{ RectF{ 0, 0, 120, 34 }, U"戻る" }; // ctorで中央上
+	T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T* p, size_t) { arena->deallocate(p); }
 
-	// レイアウト
-	static constexpr int kCols = 3;
-	const double btnW = 220, btnH = 46, gapX = 64, gapY = 60;
-	double startX = 0, startY = 150;
+	template <class U>
+	bool operator ==(const ArenaAllocator<U>& other) const { return (arena == other.arena); }
+	template <class U>
+	bool operator !=(const ArenaAllocator<U>& other) const { return (arena != other.arena); }
+};
 
-	// キーボード選択（-1: 解除 / 0: 戻る / 1: データ削除 / 2..: ステージ）
-	int focus = -1;
+// tick 内の作業用配列（tick をまたいで持たないこと）
+template <class T>
+using ScratchArray = std::vector<T, ArenaAllocator<T>>;
+
+//============================= 区間計測 =============================
+// SINLAND_PROF_SCOPE("名前") を置いたブロックの経過時間を、SINLAND_PROF_MARK("名前", 値) は一瞬の印を記録する
+// （どちらもメインスレッドだけで使う。別スレッドで測った時間は Span でメインスレッドから入れる）。
+// 記録は固定長のリングに入れ、集計する側が取り出す。溢れた分は捨てる。
+// SINLAND_PROFILE=0 でビルドするとマクロは空になり、計測のコードは残らない（ヘッドレスは既定で 0）
+# ifndef SINLAND_PROFILE
+#	if SINLAND_HEADLESS
+#		define SINLAND_PROFILE 0
+#	else
+#		define SINLAND_PROFILE 1
+#	endif
+# endif
+
+class FrameProfiler {
+public:
+	struct Sample {
+		uint16 id;        // Register の戻り値
+		uint8  depth;     // 入れ子の深さ（0 が一番外）
+		uint8  lane;      // 0: メインスレッド / 1: 読み込み
+		uint32 frame;
+		int32  arg;       // 印や読み込みに添える値（ステージ番号など）
+		int64  beginNs;   // 起動からの時刻
+		int64  durNs;     // 負なら印
+	};
 
-	void drawFocusOverlay(const RectF& r) const {
-		r.draw(ColorF{ 0,0,0, 0.12 });
-		r.stretched(-2).draw(ColorF{ 0,0,0, 0.06 });
-		r.drawFrame(2, 0, ColorF{ 0,0,0, 0.15 });
+	static constexpr bool Enabled = SINLAND_PROFILE;
+	static constexpr size_t kMaxSections = 96;
+	static constexpr uint32 kRing = 8192;
+
+	// 区間の名前を登録して番号を返す（マクロが呼び出し場所ごとに1回だけ呼ぶ）
+	static uint16 Register(const char* name) {
+		if (sectionCount == kMaxSections) return (uint16)(kMaxSections - 1);
+		names[sectionCount] = name;
+		return (uint16)sectionCount++;
 	}
+	static const char* Name(const uint16 id) { return names[id]; }
+	static size_t SectionCount() { return sectionCount; }
 
-	void loadStageNamesIfAny() {
-		TextReader r{ U"Assets/StageNames.txt" };
-		if (!r) return;
-		Array<String> lines; String line;
-		while (r.readLine(line)) { lines << line.trimmed(); if (lines.size() >= entries.size()) break; }
-		for (size_t i = 0; i < Min(lines.size(), entries.size()); ++i) {
-			if (!lines[i].isEmpty()) entries[i].name = lines[i];
-		}
+	static int64 NowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
 	}
 
-	RectF rectOfIndex(int idx) const {
-		if (idx == 0) return backBtn.rect;
-		if (idx == 1) return deleteBtn.rect;
-		const int bi = idx - 2;
-		if (bi >= 0 && bi < (int)buttons.size()) return buttons[bi].rect;
-		return RectF{};
-	}
-	bool enabledOfIndex(int idx) const {
-		if (idx == 0) return true;
-		if (idx == 1) return true;
-		const int bi = idx - 2;
-		if (bi >= 0 && bi < (int)buttons.size()) return buttons[bi].enabled;
-		return false;
-	}
-
-public:
-	using App::Scene::Scene;
+	static uint32 Frame() { return frame; }
+	static void NextFrame() { ++frame; }
 
-	Select(const InitData& init) : App::Scene(init) {
-		AudioAsset::Register(U"UIenterSE", U"Assets/UIenterSE.mp3");
-		AudioAsset(U"UIenterSE").setVolume(0.5);
-		AudioAsset::Register(U"UIselectSE", U"Assets/UIselectSE.mp3");
+	// 取り出し側（集計・書き出し）。空なら false
+	static bool Pop(Sample& out) {
+		const uint32 t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false;
+		out = ring[t % kRing];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
 
-		entries = {
-			{ U"1. 森林",       true,  State::Stage1   },
-			{ U"2. 心臓",       true,  State::Stage2   },
-			{ U"3. シャー芯",   true,  State::Stage3   },
-			{ U"4. 信号",       true,  State::Stage4   },
-			{ U"5. 真珠（準備中）", false, none            },
-			{ U"6. 分身（準備中）", false, none            },
-			{ U"7. 深海（準備中）", false, none            },
-			{ U"8. 診察（準備中）", false, none            },
-			{ U"9. 写真（準備中）", false, none            },
-			{ U"10. 振動（準備中）",false, none            },
-			{ U"11. 神（準備中）",false, none            },
-			{ U"12. 寝室",      true,  State::StageLast },
-		};
-		loadStageNamesIfAny();
+	// 計測区間の外で測った時間を入れる
+	static void Span(const uint16 id, const uint8 lane, const int64 beginNs, const int64 durNs, const int32 arg = 0) {
+		Push(Sample{ id, (uint8)Depth, lane, frame, arg, beginNs, Max<int64>(durNs, 0) });
+	}
+	static void Instant(const uint16 id, const int32 arg = 0) {
+		Push(Sample{ id, (uint8)Depth, 0, frame, arg, NowNs(), -1 });
+	}
 
-		// 戻るボタンを中央上に
-		{
-			const double w = backBtn.rect.w, h = backBtn.rect.h;
-			backBtn.rect = RectF{ Arg::center = Vec2{ Scene::CenterF().x, 37 }, w, h };
+	class Scope {
+	public:
+		explicit Scope(const uint16 id) : id{ id }, depth{ (uint8)Depth++ }, t0{ NowNs() } {}
+		~Scope() {
+			--Depth;
+			Push(Sample{ id, depth, 0, frame, 0, t0, NowNs() - t0 });
 		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
 
-		// ステージボタン（1行3）
-		const double totalW = kCols * btnW + (kCols - 1) * gapX;
-		startX = (Scene::Width() - totalW) * 0.5;
+	private:
+		uint16 id;
+		uint8  depth;
+		int64  t0;
+	};
 
-		buttons.reserve(entries.size());
-		for (int i = 0; i < (int)entries.size(); ++i) {
-			const int r = i / kCols;
-			const int c = i % kCols;
-			const RectF rect{ startX + c * (btnW + gapX), startY + r * (btnH + gapY), btnW, btnH };
-			buttons << UIButton{ rect, entries[i].name };
-		}
+private:
+	static inline const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	static inline const char* names[kMaxSections]{};
+	static inline size_t sectionCount = 0;
+	static inline uint32 frame = 0;
+	static inline uint32 Depth = 0;
+
+	static inline Sample ring[kRing]{};
+	static inline std::atomic<uint32> head{ 0 }, tail{ 0 };
+
+	static void Push(const Sample& s) {
+		if constexpr (!Enabled) return;
+		const uint32 h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= kRing) return;
+		ring[h % kRing] = s;
+		head.store(h + 1, std::memory_order_release);
 	}
+};
 
-	void update() override {
-		Scene::SetBackground(ColorF{ 0.95, 0.98, 1.0 });
+# if SINLAND_PROFILE
+#	define SINLAND_PROF_CONCAT_(a, b) a##b
+#	define SINLAND_PROF_CONCAT(a, b) SINLAND_PROF_CONCAT_(a, b)
+#	define SINLAND_PROF_SCOPE(name) \
+	static const uint16 SINLAND_PROF_CONCAT(sinlandProfId, __LINE__) = FrameProfiler::Register(name); \
+	const FrameProfiler::Scope SINLAND_PROF_CONCAT(sinlandProfScope, __LINE__){ SINLAND_PROF_CONCAT(sinlandProfId, __LINE__) }
+#	define SINLAND_PROF_MARK(name, arg) \
+	do { static const uint16 sinlandProfMark = FrameProfiler::Register(name); FrameProfiler::Instant(sinlandProfMark, (arg)); } while (0)
+# else
+#	define SINLAND_PROF_SCOPE(name) ((void)0)
+#	define SINLAND_PROF_MARK(name, arg) ((void)0)
+# endif
+
+//============================= 入力の記録 =============================
+// 1プレイ分の tick ごとの入力（4bit）とシード。同じ sim に流し直すと同じ結果になる。
+// ファイルは「入力値 連続tick数」の行が並ぶテキスト（押しっぱなしが多いので短い）
+struct InputTape {
+	static constexpr int32 kVersion = 3;   // 2: latency 行を追加 / 3: final 行を追加（1, 2 も読める）
+
+	int32 stage = 0;        // Sim::StageId
+	uint64 seed = 0;
+	bool   cleared = false; // 記録時にクリアしたか（最後の tick でクリア）
+	int32  latencyUs = -1;  // 記録時の入力の遅れの測定値（-1: 未測定）
+	bool   hasFinal = false;
+	Vec2   finalPos{ 0, 0 }; // 最後の tick を回した後のプレイヤー位置（再生の一致確認用）
+	Array<uint8> ticks;
+
+	// 上位 4bit は jumpSub
+	static uint8 Pack(const PlayerInput& in) {
+		return (uint8)((in.left ? 1 : 0) | (in.right ? 2 : 0) | (in.jump ? 4 : 0) | (in.run ? 8 : 0) | ((in.jumpSub & 15) << 4));
+	}
+	static PlayerInput Unpack(uint8 bits) {
+		PlayerInput in;
+		in.left = (bits & 1) != 0;
+		in.right = (bits & 2) != 0;
+		in.jump = (bits & 4) != 0;
+		in.run = (bits & 8) != 0;
+		in.jumpSub = (uint8)(bits >> 4);
+		return in;
+	}
 
-		// enabled 更新
-		const int unlocked = getData().unlocked;
-		for (int i = 0; i < (int)buttons.size(); ++i) {
-			const bool impl = entries[i].available && entries[i].target.has_value();
-			const bool unlockedGate = ((i + 1) <= unlocked);
-			buttons[i].text = entries[i].name;
-			buttons[i].enabled = (impl && unlockedGate);
-		}
+	double latencySec() const { return (latencyUs >= 0) ? latencyUs * 1e-6 : -1.0; }
 
-		// === マウスにホバーがあればキーボード選択を解除 ===
-		bool anyHover = deleteBtn.rect.mouseOver() || backBtn.rect.mouseOver();
-		if (!anyHover) {
-			for (const auto& b : buttons) { if (b.rect.mouseOver()) { anyHover = true; break; } }
-		}
-		if (anyHover) focus = -1;
+	void record(const PlayerInput& in) { ticks << Pack(in); }
 
-		// === キー操作 ===
-		{
-			auto ensureFocus = [&]() { if (focus == -1) focus = 0; }; // 解除中に矢印が押されたら「戻る」から再開
+	// 範囲外は無入力
+	PlayerInput at(size_t i) const { return (i < ticks.size()) ? Unpack(ticks[i]) : PlayerInput{}; }
 
-			const int prev = focus;
-			// 左右（データ削除 ↔ 戻る は左右どちらでも移動できる仕様のまま）
-			if (KeyLeft.down()) {
-				ensureFocus();
-				if (focus == 0) focus = 1;
-				else if (focus >= 2 && (focus - 2) % kCols != 0) focus -= 1;
-				else if (focus == 1) focus = 0;
-			}
-			if (KeyRight.down()) {
-				ensureFocus();
-				if (focus == 1) focus = 0;           // データ削除 -> 戻る
-				else if (focus == 0) focus = 1;      // 戻る -> データ削除
-				else if (focus >= 2 && (focus - 2) % kCols != kCols - 1 && (focus - 1) < (int)(buttons.size() + 1)) focus += 1;
-			}
-			// 上下
-			if (KeyUp.down()) {
-				ensureFocus();
-				if (focus >= 2) {
-					const int bi = focus - 2;
-					const int row = bi / kCols;
-					const int col = bi % kCols;
-					if (row == 0) focus = (col == 1 ? 0 : 1);
-					else focus -= kCols;
-				}
-			}
-			if (KeyDown.down()) {
-				ensureFocus();
-				if (focus <= 1) {
-					const int col = (focus == 0 ? 1 : 0); // back->中列, delete->左列
-					const int ni = 2 + col;
-					if (ni < 2 + (int)buttons.size()) focus = ni;
-				}
-				else if (focus + kCols < 2 + (int)buttons.size()) {
-					focus += kCols;
-				}
-			}
-			if (focus != prev && focus != -1) AudioAsset(U"UIselectSE").play();
+	bool save(const char* path) const {
+		std::FILE* fp = std::fopen(path, "w");
+		if (!fp) return false;
 
-			// 決定（解除中は無視）
-			if ((KeyEnter.down() || KeyK.down() || KeySpace.down()) && focus != -1) {
-				AudioAsset(U"UIenterSE").play();
-				if (focus == 0) { // 戻る
-					StopAllAudio();
-					changeScene(State::Title, 0.2s);
-					return;
-				}
-				if (focus == 1) { // データ削除
-					TextWriter writer{ U"Assets/SaveData.txt" };
-					if (writer) writer.writeln(U"1");
-					getData().unlocked = 1;
-					StopAllAudio();
-					changeScene(State::Title, 0.2s);
-					return;
-				}
-				const int bi = focus - 2;
-				if (bi >= 0 && bi < (int)entries.size()) {
-					if (entries[bi].available && entries[bi].target) {
-						StopAllAudio();
-						changeScene(*entries[bi].target, 0.2s);
-						return;
-					}
-				}
-			}
+		std::fprintf(fp, "sinland-replay %d\nstage %d\nseed %llu\ncleared %d\nlatency %d\nfinal %.3f %.3f\n",
+			(int)kVersion, (int)stage, (unsigned long long)seed, (cleared ? 1 : 0), (int)latencyUs, finalPos.x, finalPos.y);
+		for (size_t i = 0; i < ticks.size();) {
+			size_t n = 1;
+			while (i + n < ticks.size() && ticks[i + n] == ticks[i]) ++n;
+			std::fprintf(fp, "%u %zu\n", (unsigned)ticks[i], n);
+			i += n;
 		}
+		return (std::fclose(fp) == 0);
+	}
 
-		// === マウス操作（従来） ===
-		for (int i = 0; i < (int)buttons.size(); ++i) {
-			if (buttons[i].drawAndCheck(font)) {
-				if (entries[i].available && entries[i].target) {
-					StopAllAudio();
-					changeScene(*entries[i].target, 0.2s);
-				}
-				return;
+	bool load(const char* path) {
+		std::FILE* fp = std::fopen(path, "r");
+		if (!fp) return false;
+
+		int version = 0, st = 0, cl = 0, lat = -1;
+		unsigned long long sd = 0;
+		bool ok = (std::fscanf(fp, "sinland-replay %d stage %d seed %llu cleared %d", &version, &st, &sd, &cl) == 4)
+			&& (1 <= version && version <= kVersion);
+		if (ok && version >= 2) ok = (std::fscanf(fp, " latency %d", &lat) == 1);
+		double fx = 0.0, fy = 0.0;
+		if (ok && version >= 3) ok = (std::fscanf(fp, " final %lf %lf", &fx, &fy) == 2);
+		if (ok) {
+			stage = st; seed = sd; cleared = (cl != 0); latencyUs = lat;
+			hasFinal = (version >= 3); finalPos = Vec2{ fx, fy };
+			ticks.clear();
+			unsigned bits = 0;
+			size_t n = 0;
+			while (std::fscanf(fp, "%u %zu", &bits, &n) == 2) {
+				ticks.insert(ticks.end(), n, (uint8)bits);
 			}
 		}
-		if (deleteBtn.drawAndCheck(font)) {
-			TextWriter writer{ U"Assets/SaveData.txt" };
-			if (writer) writer.writeln(U"1");
-			getData().unlocked = 1;
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
-			return;
+		std::fclose(fp);
+		return ok;
+	}
+};
+
+//============================= 当たり判定（ブロードフェーズ） =============================
+// 一様グリッドの空間ハッシュ。矩形はハンドルで管理し、動く足場は update で差し替える
+class ColliderGrid {
+public:
+	using Handle = int32;
+
+	explicit ColliderGrid(double cellSize = 64.0) : cellSize{ cellSize } {
+		found.reserve(64);
+	}
+
+	Handle insert(const RectF& r) {
+		Handle h;
+		if (!freeList.isEmpty()) {
+			h = freeList.back(); freeList.pop_back();
+			rects[h] = r; alive[h] = true;
 		}
-		if (backBtn.drawAndCheck(font)) {
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
-			return;
+		else {
+			h = (Handle)rects.size();
+			rects << r; alive << true; stamps << 0;
 		}
+		link(h);
+		return h;
+	}
 
-		if (KeyEscape.down()) {
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
+	void remove(Handle h) {
+		if (!alive[h]) return;
+		unlink(h);
+		alive[h] = false;
+		freeList << h;
+	}
+
+	// 外したハンドルは無視する（グリッドに戻さない）
+	void update(Handle h, const RectF& r) {
+		if (!alive[h] || rects[h] == r) return;
+		unlink(h);
+		rects[h] = r;
+		link(h);
+	}
+
+	void clear() {
+		cells.clear(); rects.clear(); alive.clear(); stamps.clear(); freeList.clear();
+	}
+
+	// 動く足場が通る範囲のセルを先に作っておく（プレイ中に update でセルが増えて確保が走らないように）
+	void reserve(const RectF& area, size_t perCell = 4) {
+		forEachCell(area, [&](uint64 key) { cells[key].reserve(perCell); });
+	}
+
+	const RectF& rect(Handle h) const { return rects[h]; }
+	size_t size() const { return (rects.size() - freeList.size()); }
+
+	// area と同じセルにある矩形のハンドル（重複なし・登録順）。次の query まで有効
+	const Array<Handle>& query(const RectF& area) const {
+		found.clear();
+		if (++stampNow == 0) { // 一周したら印を全消し
+			for (auto& s : stamps) s = 0;
+			stampNow = 1;
 		}
+		forEachCell(area, [&](uint64 key) {
+			const auto it = cells.find(key);
+			if (it == cells.end()) return;
+			for (const Handle h : it->second) {
+				if (stamps[h] == stampNow) continue;
+				stamps[h] = stampNow;
+				found << h;
+			}
+		});
+		std::sort(found.begin(), found.end()); // 全件走査と同じ順で押し戻すため
+		return found;
 	}
 
-	void draw() const override {
-		// 上部
-		deleteBtn.draw(font);
-		backBtn.draw(font);
-		// ステージ
-		for (const auto& b : buttons) b.draw(font);
-		// キーボードフォーカスは focus!=-1 かつ有効時のみ
-		if (focus != -1 && enabledOfIndex(focus)) {
-			drawFocusOverlay(rectOfIndex(focus));
+	bool overlaps(const RectF& r) const {
+		for (const Handle h : query(r)) {
+			if (r.intersects(rects[h])) return true;
+		}
+		return false;
+	}
+
+private:
+	double cellSize;
+	HashTable<uint64, Array<Handle>> cells;
+	Array<RectF>  rects;
+	Array<bool>   alive;
+	Array<Handle> freeList;
+
+	// query 用の作業領域
+	mutable Array<uint32> stamps;
+	mutable uint32        stampNow = 0;
+	mutable Array<Handle> found;
+
+	static uint64 Key(int32 cx, int32 cy) {
+		return ((uint64)(uint32)cx << 32) | (uint32)cy;
+	}
+
+	template <class Fn>
+	void forEachCell(const RectF& r, Fn&& fn) const {
+		const int32 x0 = (int32)Math::Floor(r.x / cellSize);
+		const int32 y0 = (int32)Math::Floor(r.y / cellSize);
+		const int32 x1 = (int32)Math::Floor((r.x + r.w) / cellSize);
+		const int32 y1 = (int32)Math::Floor((r.y + r.h) / cellSize);
+		for (int32 cy = y0; cy <= y1; ++cy) {
+			for (int32 cx = x0; cx <= x1; ++cx) fn(Key(cx, cy));
 		}
 	}
+
+	void link(Handle h) {
+		forEachCell(rects[h], [&](uint64 key) { cells[key] << h; });
+	}
+
+	void unlink(Handle h) {
+		forEachCell(rects[h], [&](uint64 key) {
+			auto& list = cells[key];
+			const auto it = std::find(list.begin(), list.end(), h);
+			if (it != list.end()) { *it = list.back(); list.pop_back(); }
+		});
+	}
 };
 
+//============================= パーティクル =============================
+// 容量固定の粒のプール。要素ごとの配列（SoA）に持ち、生きている粒は先頭に詰めておく。
+// 更新は「重力」「移動」「床」「フェード」「縮小」をそれぞれ配列の頭から流すだけの
+// 分岐のないループにして、コンパイラがまとめて計算（ベクトル化）できる形にしている
+class ParticlePool {
+public:
+	enum class Shape : uint8 { Circle, Ring, Rect };
+
+	struct Params {
+		Shape shape = Shape::Circle;
+		float gravity = 0.0f;       // px/s^2
+		float fade = 0.0f;          // 1秒あたりに失う alpha の割合
+		float floorY = 1e30f;       // これより下には行かない（着くと縦の速度は 0）
+		float killY = 1e30f;        // これより下に出たら消す
+		float minAlpha = 0.0f;      // これより薄くなったら消す
+		float ringWidth = 0.25f;    // Ring の線の太さ（半径に対する比）
+	};
 
-//============================= ステージ基底 =============================
-class StageBase : public App::Scene {
-protected:
-	Font font{ 18 }, head{ 22, Typeface::Bold };
-	const Size sceneSize{ 960, 640 };
-	Array<RectF> platforms;
-	Array<RectF> colliders;
-	RectF goal{ 840, 520, 80, 60 };
-	Player player;
+	struct Spawn {
+		Vec2   pos{ 0, 0 };         // Circle / Ring は中心、Rect は左上
+		Vec2   vel{ 0, 0 };
+		double size = 1.0;          // Circle / Ring は半径、Rect は幅
+		double height = 0.0;        // Rect の高さ
+		double angle = 0.0;         // Rect の傾き
+		double alpha = 1.0;
+		double shrink = 0.0;        // 1秒あたりに縮む割合
+	};
 
-	virtual void drawBackground() const {
-		Scene::SetBackground(ColorF{ 0.95, 0.98, 1.0 });
+	ParticlePool(size_t capacity, const Params& params) : params{ params } {
+		setCapacity(capacity);
 	}
 
-	void drawLevel() const {
-		for (const auto& pf : platforms) {
-			pf.draw(ColorF{ 0.75, 0.78, 0.82 });
-			pf.drawFrame(2, 0, ColorF{ 0.2, 0.25, 0.3, 0.4 });
-		}
+	// 容量を変える（生きている粒は消える）。tick の外で呼ぶ
+	void setCapacity(size_t capacity) {
+		for (auto* a : { &x, &y, &vx, &vy, &w, &h, &angle, &alpha, &shrink }) a->resize(capacity);
+		n = 0;
 	}
 
-	void uiCommon(const String& name) const {
-		(void)name;
+	// 満杯なら false（既存の粒は押しのけない）
+	bool emit(const Spawn& s) {
+		if (n == x.size()) return false;
+		x[n] = (float)s.pos.x;  y[n] = (float)s.pos.y;
+		vx[n] = (float)s.vel.x; vy[n] = (float)s.vel.y;
+		w[n] = (float)s.size;   h[n] = (float)s.height;
+		angle[n] = (float)s.angle;
+		alpha[n] = (float)s.alpha;
+		shrink[n] = (float)s.shrink;
+		++n;
+		return true;
 	}
 
-public:
-	using App::Scene::Scene;
+	// gen(i) が返す Spawn を count 個まとめて出す。出せた数を返す
+	template <class Gen>
+	size_t emitBurst(size_t count, Gen&& gen) {
+		size_t i = 0;
+		for (; i < count && emit(gen(i)); ++i) {}
+		return i;
+	}
 
-	void update() override {
-		player.update(colliders);
-		player.advanceAnim();
+	void update(double dt) {
+		const float t = (float)dt;
+		if (params.gravity != 0.0f) applyGravity(t);
+		integrate(t);
+		if (params.floorY < 1e30f) applyFloor();
+		if (params.fade != 0.0f) applyFade(t);
+		applyShrink(t);
+		cull();
+	}
 
-		if (KeyEscape.down())
-		{
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
+	void clear() { n = 0; }
+	size_t size() const { return n; }
+	size_t capacity() const { return x.size(); }
+	Vec2 position(size_t i) const { return Vec2{ x[i], y[i] }; }
+
+# if !SINLAND_HEADLESS
+	// 1種類の図形を状態を変えずに続けて描く（Siv3D 側で1回の描画コールにまとまる）
+	void draw(const ColorF& color) const {
+		for (size_t i = 0; i < n; ++i) {
+			const ColorF c = color.withAlpha(color.a * alpha[i]);
+			switch (params.shape) {
+			case Shape::Circle: Circle{ x[i], y[i], w[i] }.draw(c); break;
+			case Shape::Ring:   Circle{ x[i], y[i], w[i] }.drawFrame(w[i] * params.ringWidth, c); break;
+			case Shape::Rect:   RectF{ x[i], y[i], w[i], h[i] }.rotated(angle[i]).draw(c); break;
+			}
 		}
 	}
+# endif
 
-	void draw() const override {
-		drawBackground();
+private:
+	Params params;
+	size_t n = 0;   // 生きている粒の数（[0, n) が有効）
+	Array<float> x, y, vx, vy;
+	Array<float> w, h, angle;
+	Array<float> alpha, shrink;
+
+	void applyGravity(float t) {
+		const float dv = params.gravity * t;
+		float* __restrict py = vy.data();
+		for (size_t i = 0; i < n; ++i) py[i] += dv;
+	}
 
-		drawLevel();
-		player.draw();
+	void integrate(float t) {
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+		const float* __restrict pvx = vx.data();
+		const float* __restrict pvy = vy.data();
+		for (size_t i = 0; i < n; ++i) { px[i] += pvx[i] * t; py[i] += pvy[i] * t; }
 	}
 
-	virtual void onClear() = 0;
-};
+	void applyFloor() {
+		const float f = params.floorY;
+		float* __restrict py = y.data();
+		float* __restrict pvy = vy.data();
+		for (size_t i = 0; i < n; ++i) {
+			const bool below = (py[i] > f);
+			py[i] = below ? f : py[i];
+			pvy[i] = below ? 0.0f : pvy[i];
+		}
+	}
 
-//---------------------------------- Stage1 -----------------------------
-class Stage1 : public
-	StageBase {
-private:
-	// ---- サル ----
-	struct Monkey {
-		enum class Phase { Waiting, Entering, Eating, Leaving };
-		Phase phase = Phase::Waiting;
-		double t = 0.0;
-		Vec2 pos{ 1000, 520 };
-		int fruitIndex = 0;
-		bool triggered = false;
+	void applyFade(float t) {
+		const float k = Max(0.0f, 1.0f - params.fade * t);
+		float* __restrict pa = alpha.data();
+		for (size_t i = 0; i < n; ++i) pa[i] *= k;
+	}
 
-		void startIfTriggered(const Vec2& playerPos) {
-			if (!triggered && playerPos.x > 400) {
-				triggered = true; phase = Phase::Entering; t = 0.0;
-				pos = Vec2{ 1000, 520 }; fruitIndex = 0;
-				AudioAsset(U"monkeySE").play();
+	void applyShrink(float t) {
+		float* __restrict pw = w.data();
+		float* __restrict ph = h.data();
+		const float* __restrict ps = shrink.data();
+		for (size_t i = 0; i < n; ++i) {
+			const float k = 1.0f - ps[i] * t;
+			pw[i] *= k;
+			ph[i] *= k;
+		}
+	}
+
+	// 消える粒を末尾の粒で埋める（順番は保たない）
+	void cull() {
+		for (size_t i = 0; i < n;) {
+			if ((alpha[i] <= params.minAlpha) || (y[i] > params.killY)) {
+				--n;
+				for (auto* a : { &x, &y, &vx, &vy, &w, &h, &angle, &alpha, &shrink }) (*a)[i] = (*a)[n];
+			}
+			else {
+				++i;
 			}
 		}
-		void update(double dt) {
-			switch (phase) {
-			case Phase::Waiting: break;
-			case Phase::Entering:
-				pos.x -= 100 * dt; t += dt;
-				if (pos.x <= 760) { pos.x = 760; phase = Phase::Eating; t = 0.0; fruitIndex = 0; }
-				break;
-			case Phase::Eating:
-				t += dt; {
-					const double fruitDuration = 1.0;
+	}
+};
+
+//============================= プレイヤー =============================
+struct Player {
+	Size  size{ 28, 36 };
+	Vec2  pos{ 120, 540 };
+	Vec2  prevPos{ 120, 540 };
+	Vec2  tickFrom{ 120, 540 };   // 描画補間用：現 tick 開始時の位置
+	Vec2  vel{ 0, 0 };
+	bool  grounded = false;
+	bool  jumpedThisFrame = false;
+	double walkPhase = 0.0;
+	double interp = 1.0;          // 描画補間係数（tickFrom → pos）
+
+	double gravity = 1800.0;
+	double moveAccel = 2400.0;
+	double airAccel = 1400.0;
+	double maxSpeedX = 260.0;
+	double jumpSpeed = 560.0;
+	double groundFric = 14.0;
+	double airFric = 2.0;
+
+	bool update(const ColliderGrid& colliders, const PlayerInput& in, double dt) {
+		SINLAND_PROF_SCOPE("Player::update");
+		prevPos = pos;
+		jumpedThisFrame = false;
+		const bool left = in.left;
+		const bool right = in.right;
+		const bool jumpPressed = in.jump;
+		const bool running = in.run;
+
+		double ax = 0.0;
+		if (left ^ right) {
+			const double a = grounded ? moveAccel : airAccel;
+			ax = (left ? -a : a);
+		}
+		const double maxX = running ? (maxSpeedX * 1.4) : maxSpeedX;
+
+		vel.x += ax * dt;
+		vel.x -= vel.x * Min((grounded ? groundFric : airFric) * dt, 1.0);
+		vel.x = Clamp(vel.x, -maxX, maxX);
+
+		vel.y += gravity * dt;
+
+		if (grounded && jumpPressed) {
+			vel.y = -jumpSpeed;
+			grounded = false;
+			jumpedThisFrame = true;
+		}
+
+		moveAndCollide(colliders, dt);
+		return true;
+	}
+
+	// ---- 移動＋衝突解決 ----
+	static constexpr double kMaxSubstepPx = 4.0;  // 1サブステップの最大移動量（最薄の芯 6px より小さく）
+	static constexpr int    kMaxSubsteps = 16;
+
+	// vel * dt だけ動かす。軸ごとにスイープして最初に当たる面で止める（すり抜け防止）
+	void moveAndCollide(const ColliderGrid& colliders, double dt) {
+		const double travel = Max(Abs(vel.x), Abs(vel.y)) * dt;
+		const int steps = Clamp((int)Math::Ceil(travel / kMaxSubstepPx), 1, kMaxSubsteps);
+		const double h = dt / steps;
+
+		grounded = false;
+		for (int i = 0; i < steps; ++i) {
+			sweepX(colliders, vel.x * h);
+			sweepY(colliders, vel.y * h);
+		}
+	}
+
+	void sweepX(const ColliderGrid& colliders, double dx) {
+		if (dx == 0.0) return;
+		const RectF from{ pos, size };
+		const RectF swept = (dx > 0) ? RectF{ pos.x, pos.y, size.x + dx, (double)size.y }
+									 : RectF{ pos.x + dx, pos.y, size.x - dx, (double)size.y };
+		double move = dx;
+		bool hit = false;
+		for (const auto h : colliders.query(swept)) {
+			const RectF& c = colliders.rect(h);
+			if (!(from.y < c.y + c.h && c.y < from.y + from.h)) continue;
+			if (dx > 0 && from.x + from.w <= c.x) {
+				const double m = c.x - size.x - 0.01 - pos.x;
+				if (m < move) { move = m; hit = true; }
+			}
+			else if (dx < 0 && c.x + c.w <= from.x) {
+				const double m = c.x + c.w + 0.01 - pos.x;
+				if (m > move) { move = m; hit = true; }
+			}
+		}
+		pos.x += move;
+		if (hit) vel.x = 0;
+
+		// 始めから重なっていたもの（伸びてきた芯など）は従来どおり押し戻す
+		RectF aabb{ pos, size };
+		for (const auto h : colliders.query(aabb)) {
+			const RectF& c = colliders.rect(h);
+			if (!aabb.intersects(c)) continue;
+			if (dx > 0) pos.x = c.x - size.x - 0.01;
+			else pos.x = c.x + c.w + 0.01;
+			vel.x = 0;
+			aabb.setPos(pos);
+		}
+	}
+
+	void sweepY(const ColliderGrid& colliders, double dy) {
+		if (dy == 0.0) return;
+		const RectF from{ pos, size };
+		const RectF swept = (dy > 0) ? RectF{ pos.x, pos.y, (double)size.x, size.y + dy }
+									 : RectF{ pos.x, pos.y + dy, (double)size.x, size.y - dy };
+		double move = dy;
+		bool hit = false;
+		for (const auto h : colliders.query(swept)) {
+			const RectF& c = colliders.rect(h);
+			if (!(from.x < c.x + c.w && c.x < from.x + from.w)) continue;
+			if (dy > 0 && from.y + from.h <= c.y) {
+				const double m = c.y - size.y - 0.01 - pos.y;
+				if (m < move) { move = m; hit = true; }
+			}
+			else if (dy < 0 && c.y + c.h <= from.y) {
+				const double m = c.y + c.h + 0.01 - pos.y;
+				if (m > move) { move = m; hit = true; }
+			}
+		}
+		pos.y += move;
+		if (hit) {
+			if (dy > 0) grounded = true;
+			vel.y = 0;
+		}
+
+		RectF aabb{ pos, size };
+		for (const auto h : colliders.query(aabb)) {
+			const RectF& c = colliders.rect(h);
+			if (!aabb.intersects(c)) continue;
+			if (dy > 0) { pos.y = c.y - size.y - 0.01; grounded = true; }
+			else pos.y = c.y + c.h + 0.01;
+			vel.y = 0;
+			aabb.setPos(pos);
+		}
+	}
+
+	void advanceAnim(double dt) {
+		const bool isMovingHoriz = (Math::Abs(vel.x) > 1.0);
+		if (isMovingHoriz && grounded) {
+			walkPhase += dt * Math::TwoPi * (8.0 / 2.0);
+		}
+	}
+
+	// tick 開始時に呼ぶ（描画補間の始点）
+	void beginTick() { tickFrom = pos; }
+
+	// ワープ（補間・着地判定に前位置を引きずらない）
+	void snapTo(const Vec2& p) { pos = p; prevPos = p; tickFrom = p; }
+
+	Vec2 renderPos() const { return tickFrom.lerp(pos, interp); }
+
+# if !SINLAND_HEADLESS
+	// アトラスのコマ：目線の向き 4 ×（止まり 1 ＋ 歩きの位相 8）
+	static constexpr int32 kWalkFrames = 8;
+	static constexpr int32 kSpriteFrames = 4 * (1 + kWalkFrames);
+
+	void draw(DrawList& list) const {
+		const bool isMovingHoriz = (Math::Abs(vel.x) > 1.0);
+		const Vec2 rp = renderPos();
+
+		list.add(Circle{ rp + Vec2{ size.x * 0.5, size.y + 6 }, 12 },
+			ColorF{ 0, 0, 0, grounded ? 0.18 : 0.10 });
+
+		const Vec2 center = rp + Vec2{ size } / 2;
+		const bool walking = (isMovingHoriz && grounded);
+		const double tilt = (isMovingHoriz ? Clamp(vel.x / maxSpeedX, -1.0, 1.0) * 0.12 : 0.0);
+		const int32 face = (Math::Abs(vel.x) > Math::Abs(vel.y)) ? (vel.x >= 0 ? 0 : 1) : (vel.y >= 0 ? 2 : 3);
+
+		// 焼いたコマは位相を丸めるので、回転の中心も止まり姿勢の胴体中心で代用する（ずれは 1px 未満）
+		const int32 pose = walking ? (1 + (int32)((int64)Math::Round(walkPhase * kWalkFrames / Math::TwoPi) % kWalkFrames)) : 0;
+		if (SpriteAtlas::Add(list, Sprite::Player, face * (1 + kWalkFrames) + pose, center, Vec2{ 1, 1 }, tilt, Vec2{ 0, -4 })) {
+			return;
+		}
+
+		const double step = walking ? (6.0 * Math::Sin(walkPhase * 2.0)) : 0.0;
+		const double swing = walking ? (12.0 * Math::Sin(walkPhase)) : 0.0;
+		list.setTransform(Mat3x2::Rotate(tilt, center.movedBy(0, -4 + step)));
+		PaintBody(list, size, center, step, swing, face);
+		list.resetTransform();
+	}
+
+	// 影から上の体。center は止まり姿勢の中心、face は目線（0:右 1:左 2:下 3:上）
+	static void PaintBody(DrawList& list, const Size& size, const Vec2& center, double step, double swing, int32 face) {
+		const RoundRect body{ RectF{ Arg::center = center.movedBy(0, -4 + step), size }, 6.0 };
+		list.add(body, ColorF{ 0.1, 0.1, 0.12 });
+
+		const Circle head{ center.movedBy(0, -size.y * 0.9 + step), 14 };
+		list.add(head, ColorF{ 0.95 });
+
+		constexpr Vec2 faceDirs[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+		const Vec2 eyeOffset = faceDirs[face] * Vec2{ 4, 3 } *0.5;
+		list.add(Circle{ head.center.movedBy(-5, -2) + eyeOffset, 1.6 }, ColorF{ 0.08 });
+		list.add(Circle{ head.center.movedBy(5, -2) + eyeOffset, 1.6 }, ColorF{ 0.08 });
+
+		const Vec2 armBaseL = body.rect.center().movedBy(-size.x * 0.6, -size.y * 0.2 + step);
+		const Vec2 armBaseR = body.rect.center().movedBy(size.x * 0.6, -size.y * 0.2 + step);
+		list.add(Line{ armBaseL, armBaseL.movedBy(0, 14 + swing * 0.2) }, 4, ColorF{ 0.15 });
+		list.add(Line{ armBaseR, armBaseR.movedBy(0, 14 - swing * 0.2) }, 4, ColorF{ 0.15 });
+
+		const Vec2 footBase = body.rect.center().movedBy(0, size.y * 0.5 + step);
+		const Vec2 footL = footBase.movedBy(-8 - swing, 8);
+		const Vec2 footR = footBase.movedBy(8 + swing, 8);
+		list.add(Line{ footBase.movedBy(-6, -4), footL }, 5, ColorF{ 0.12 });
+		list.add(Line{ footBase.movedBy(6, -4), footR }, 5, ColorF{ 0.12 });
+		list.add(Circle{ footL, 4 }, ColorF{ 0.2 });
+		list.add(Circle{ footR, 4 }, ColorF{ 0.2 });
+	}
+
+	// アトラスの frame 番目（中心を原点に描く）
+	static void PaintSpriteFrame(DrawList& list, const Size& size, int32 frame) {
+		const int32 face = frame / (1 + kWalkFrames);
+		const int32 pose = frame % (1 + kWalkFrames);
+		const double phase = (pose - 1) * Math::TwoPi / kWalkFrames;
+		const double step = (pose == 0) ? 0.0 : (6.0 * Math::Sin(phase * 2.0));
+		const double swing = (pose == 0) ? 0.0 : (12.0 * Math::Sin(phase));
+		PaintBody(list, size, Vec2{ 0, 0 }, step, swing, face);
+	}
+# endif
+};
+
+//============================= ステージ共通 =============================
+static constexpr double SimTickHz = 120.0;
+static constexpr double SimTickDt = 1.0 / SimTickHz;
+
+// 描画フレームの経過時間を tick に切り分ける。1フレームで回す tick には上限があり、
+// 上限を超えて溜まった分は捨てる（処理落ち）。捨てた分だけ sim は実時間より遅れたままになる
+struct FixedStepper {
+	static constexpr int kMaxTicksPerFrame = 8;   // 極端に重いフレームでの tick 溜まり防止
+	double accum = 0.0;
+	int    ticks = 0;
+
+	void beginFrame(const double dt) { accum += dt; ticks = 0; }
+	bool due() const { return (accum >= SimTickDt && ticks < kMaxTicksPerFrame); }
+	void consume() { accum -= SimTickDt; ++ticks; }
+	// フレームの最後に呼ぶ。捨てた秒数を返す
+	double dropOverflow() {
+		if (accum < SimTickDt) return 0.0;
+		const double dropped = accum;
+		accum = 0.0;
+		return dropped;
+	}
+};
+
+// sim が持つ物の数。既定はゲームと同じで、ベンチの --stress k で k 倍にする
+struct SimLoad {
+	int32 fruits = 4;          // Stage1 の木の果物（スワップは両端、ローテートは全体を1つずらす）
+	int32 leadFragments = 1;   // Stage3 で芯が折れたときの破片の数（同時に落ちる破片はこの 8 倍まで）
+	int32 cars = 2;            // Stage4 の車（レーンを等間隔に割り振る）
+	int32 rings = 1;           // タイトルの輪を1回に出す数（同時に出ている輪はこの 8 倍まで）
+
+	static SimLoad Scaled(const int32 k) { return SimLoad{ 4 * k, k, 2 * k, k }; }
+};
+
+static ColliderGrid MakeLevelColliders(const Size sceneSize, const Array<RectF>& platforms) {
+	ColliderGrid cols;
+	for (const auto& pf : platforms) cols.insert(pf);
+	cols.insert(RectF{ -100, 0, 100, (double)sceneSize.y });
+	cols.insert(RectF{ (double)sceneSize.x, 0, 100, (double)sceneSize.y });
+	return cols;
+}
+
+// ステージの状態と 1tick 分の更新
+struct StageSim {
+	const Size sceneSize{ 960, 640 };
+	Array<RectF> platforms;
+	ColliderGrid colliders;
+	Player player;
+	double simTime = 0.0;           // tick 積算の時刻（開始=0）
+	double inputLatency = -1.0;     // 測定した入力の遅れ（秒）。負なら未測定（ステージの既定値を使う）
+	bool   cleared = false;         // Cleared を出したら以降は進めない
+	Array<SimEvent> events;         // 受け取った側が処理して空にする
+	FrameArena scratch;             // tick 内の作業領域（step の頭で空にする）
+
+	template <class T>
+	ScratchArray<T> makeScratch(size_t n = 0) { return ScratchArray<T>(n, T{}, ArenaAllocator<T>{ scratch }); }
+
+	StageSim() { events.reserve(16); }
+	virtual ~StageSim() = default;
+
+	void step(const PlayerInput& in, double dt) {
+		scratch.reset();
+		player.beginTick();
+		tick(in, dt);
+		simTime += dt;
+	}
+
+protected:
+	virtual void tick(const PlayerInput& in, double dt) {
+		player.update(colliders, in, dt);
+		player.advanceAnim(dt);
+	}
+
+	void emit(SimEvent e) { events << e; }
+
+	void finish() {
+		if (cleared) return;
+		cleared = true;
+		emit(SimEvent::Cleared);
+	}
+};
+
+//============================= Stage1（森林） =============================
+struct Stage1Sim : StageSim {
+	static constexpr int32 StageId = 1;
+
+	// ---- サル ----
+	struct Monkey {
+		enum class Phase { Waiting, Entering, Eating, Leaving };
+		Phase phase = Phase::Waiting;
+		double t = 0.0;
+		Vec2 pos{ 1000, 520 };
+		int fruitIndex = 0;
+		bool triggered = false;
+
+		void startIfTriggered(const Vec2& playerPos, Array<SimEvent>& events) {
+			if (!triggered && playerPos.x > 400) {
+				triggered = true; phase = Phase::Entering; t = 0.0;
+				pos = Vec2{ 1000, 520 }; fruitIndex = 0;
+				events << SimEvent::PlayMonkey;
+			}
+		}
+		void update(double dt, Array<SimEvent>& events) {
+			switch (phase) {
+			case Phase::Waiting: break;
+			case Phase::Entering:
+				pos.x -= 100 * dt; t += dt;
+				if (pos.x <= 760) { pos.x = 760; phase = Phase::Eating; t = 0.0; fruitIndex = 0; }
+				break;
+			case Phase::Eating:
+				t += dt; {
+					const double fruitDuration = 1.0;
 					fruitIndex = (int)(t / fruitDuration);
 					if (fruitIndex > 3) {
 						phase = Phase::Leaving; t = 0.0;
-						AudioAsset(U"monkeySE").play();
+						events << SimEvent::PlayMonkey;
 					}
 				}
 				break;
@@ -620,140 +1403,157 @@ private:
 			if (phase == Phase::Waiting && triggered) {
 				t += dt; if (t > 2.0) {
 					phase = Phase::Entering; t = 0.0; pos = Vec2{ 1000,520 }; fruitIndex = 0;
-					AudioAsset(U"monkeySE").play();
+					events << SimEvent::PlayMonkey;
 				}
 			}
 		}
 
-		// 果物描画（サルと木で共有）
-		static void DrawFruit(int fruitIndex, const Vec2& p) {
+# if !SINLAND_HEADLESS
+		// 果物（サルと木で共有）
+		static void DrawFruit(DrawList& list, int fruitIndex, const Vec2& p) {
+			if (SpriteAtlas::Add(list, Sprite::Fruit, fruitIndex, p)) return;
+			PaintFruit(list, fruitIndex, p);
+		}
+
+		static void PaintFruit(DrawList& list, int fruitIndex, const Vec2& p) {
 			switch (fruitIndex) {
 			case 0: { // りんご
-				Circle{ p, 10 }.draw(ColorF{ 0.9, 0.05, 0.05 });
-				Circle{ p.movedBy(-3,-3), 4 }.draw(ColorF{ 1.0, 0.8, 0.8, 0.6 });
-				RectF{ p.movedBy(-1,-14), 2, 6 }.draw(ColorF{ 0.2,0.3,0.2 });
-				Triangle{ p.movedBy(0,-14), p.movedBy(6,-18), p.movedBy(2,-20) }.draw(ColorF{ 0.2,0.5,0.2 });
+				list.add(Circle{ p, 10 }, ColorF{ 0.9, 0.05, 0.05 });
+				list.add(Circle{ p.movedBy(-3,-3), 4 }, ColorF{ 1.0, 0.8, 0.8, 0.6 });
+				list.add(RectF{ p.movedBy(-1,-14), 2, 6 }, ColorF{ 0.2,0.3,0.2 });
+				list.add(Triangle{ p.movedBy(0,-14), p.movedBy(6,-18), p.movedBy(2,-20) }, ColorF{ 0.2,0.5,0.2 });
 			} break;
 			case 1: { // ばなな
 				const Vec2 b0 = p.movedBy(-16, 0);
 				const Vec2 b1 = p.movedBy(0, -10);
 				const Vec2 b2 = p.movedBy(16, -2);
 				for (int i = -2; i <= 2; ++i)
-					Bezier2{ b0.movedBy(0,i), b1.movedBy(0,i), b2.movedBy(0,i) }.draw(4, ColorF{ 0.98, 0.9, 0.3 });
-				Circle{ b2, 3 }.draw(ColorF{ 0.4,0.3,0.1 });
+					list.add(Bezier2{ b0.movedBy(0,i), b1.movedBy(0,i), b2.movedBy(0,i) }, 4, ColorF{ 0.98, 0.9, 0.3 });
+				list.add(Circle{ b2, 3 }, ColorF{ 0.4,0.3,0.1 });
 			} break;
 			case 2: { // もも
-				Circle{ p.movedBy(-5,0), 11 }.draw(ColorF{ 1.0, 0.75, 0.8 });
-				Circle{ p.movedBy(5,0), 11 }.draw(ColorF{ 1.0, 0.70, 0.7 });
-				RectF{ p.movedBy(-1,-8), 2, 16 }.draw(ColorF{ 1.0,0.8,0.85,0.4 });
-				Triangle{ p.movedBy(0,-12), p.movedBy(8,-16), p.movedBy(2,-18) }.draw(ColorF{ 0.4,0.7,0.4 });
+				list.add(Circle{ p.movedBy(-5,0), 11 }, ColorF{ 1.0, 0.75, 0.8 });
+				list.add(Circle{ p.movedBy(5,0), 11 }, ColorF{ 1.0, 0.70, 0.7 });
+				list.add(RectF{ p.movedBy(-1,-8), 2, 16 }, ColorF{ 1.0,0.8,0.85,0.4 });
+				list.add(Triangle{ p.movedBy(0,-12), p.movedBy(8,-16), p.movedBy(2,-18) }, ColorF{ 0.4,0.7,0.4 });
 			} break;
 			case 3: { // ぶどう
 				const ColorF grape{ 0.5,0.2,0.7 };
-				Circle{ p.movedBy(0,-6), 6 }.draw(grape);
-				Circle{ p.movedBy(-6, 0), 6 }.draw(grape);
-				Circle{ p.movedBy(6, 0), 6 }.draw(grape);
-				Circle{ p.movedBy(0, 6), 6 }.draw(grape);
-				Circle{ p.movedBy(-4,10), 5 }.draw(grape);
-				Circle{ p.movedBy(4,10), 5 }.draw(grape);
-				RectF{ p.movedBy(-1,-16), 2, 6 }.draw(ColorF{ 0.2,0.3,0.2 });
+				list.add(Circle{ p.movedBy(0,-6), 6 }, grape);
+				list.add(Circle{ p.movedBy(-6, 0), 6 }, grape);
+				list.add(Circle{ p.movedBy(6, 0), 6 }, grape);
+				list.add(Circle{ p.movedBy(0, 6), 6 }, grape);
+				list.add(Circle{ p.movedBy(-4,10), 5 }, grape);
+				list.add(Circle{ p.movedBy(4,10), 5 }, grape);
+				list.add(RectF{ p.movedBy(-1,-16), 2, 6 }, ColorF{ 0.2,0.3,0.2 });
 			} break;
 			}
 		}
 
-		void draw() const
+		// アトラスのコマ：歩きの位相 8 ／ 座り（手ぶら＋果物 4 種）
+		static constexpr int32 kWalkFrames = 8;
+		static constexpr int32 kSitFrames = 5;
+		static constexpr double kGroundY = 580.0;
+
+		void draw(DrawList& list) const
 		{
 			if (phase == Phase::Waiting && !triggered) return;
 
-			// 明るめ茶系
-			const ColorF furColor{ 0.55, 0.33, 0.18 };
-			const ColorF faceColor{ 0.97, 0.90, 0.80 };
-			const ColorF eyeColor{ 0.10, 0.07, 0.07 };
-			const double groundY = 580.0;
-			const Vec2 c = pos;
+			const Vec2 base{ pos.x, kGroundY };
+			if (phase == Phase::Entering || phase == Phase::Leaving) {
+				const int32 frame = (int32)((int64)Math::Round(t * 8.0 * kWalkFrames / Math::TwoPi) % kWalkFrames);
+				if (SpriteAtlas::Add(list, Sprite::MonkeyWalk, frame, base)) return;
+				PaintWalking(list, base, Math::Sin(t * 8.0) * 6.0);
+			}
+			else {
+				const int holding = (phase == Phase::Eating) ? fruitIndex : -1;
+				if (SpriteAtlas::Add(list, Sprite::MonkeySit, holding + 1, base)) return;
+				PaintSitting(list, base, holding);
+			}
+		}
 
-			auto drawSitting = [&](const Vec2& cPos, bool holdingFruit)
-				{
-					const double bodyBottom = groundY;
-					const double bodyTop = bodyBottom - 28;
-					const double bodyCenterY = (bodyTop + bodyBottom) / 2;
-					const double faceY = bodyTop - 12;
-
-					// 頭（外＝毛 / 内＝顔）
-					Circle{ Vec2{ cPos.x, faceY }, 16 }.draw(furColor);
-					Circle{ Vec2{ cPos.x, faceY + 2 }, 12 }.draw(faceColor);
-					// 耳
-					Circle{ Vec2{ cPos.x - 16, faceY + 2 }, 6 }.draw(furColor);
-					Circle{ Vec2{ cPos.x + 16, faceY + 2 }, 6 }.draw(furColor);
-					// 目
-					Circle{ Vec2{ cPos.x - 4, faceY }, 2 }.draw(eyeColor);
-					Circle{ Vec2{ cPos.x + 4, faceY }, 2 }.draw(eyeColor);
-					// 胴体
-					RoundRect{ RectF{ Arg::center = Vec2{ cPos.x, bodyCenterY }, 30, 28 }, 6 }.draw(furColor);
-					// 足
-					RectF{ cPos.x - 12, bodyBottom - 14, 10, 14 }.draw(furColor);
-					RectF{ cPos.x + 2, bodyBottom - 14, 10, 14 }.draw(furColor);
-					RoundRect{ RectF{ cPos.x - 14, groundY - 8, 10, 8 }, 2 }.draw(furColor);
-					RoundRect{ RectF{ cPos.x + 2, groundY - 8, 10, 8 }, 2 }.draw(furColor);
-					// しっぽ
-					{
-						const Vec2 base = Vec2{ cPos.x + 16, bodyBottom - 16 };
-						Bezier2{ base, base.movedBy(10,-10), base.movedBy(0,-20) }.draw(4, furColor);
-					}
-					// 腕
-					if (holdingFruit) {
-						RectF{ cPos.x - 20, faceY + 4, 6, -24 }.draw(furColor);
-						RectF{ cPos.x + 14, faceY + 4, 6, -24 }.draw(furColor);
-						DrawFruit(fruitIndex, Vec2{ cPos.x, faceY - 28 });
-					}
-					else {
-						RectF{ cPos.x - 16, bodyBottom - 20, 8, 16 }.draw(furColor);
-						RectF{ cPos.x + 8, bodyBottom - 20, 8, 16 }.draw(furColor);
-					}
-				};
+		// 明るめ茶系
+		static inline const ColorF furColor{ 0.55, 0.33, 0.18 };
+		static inline const ColorF faceColor{ 0.97, 0.90, 0.80 };
+		static inline const ColorF eyeColor{ 0.10, 0.07, 0.07 };
 
-			auto drawWalking = [&](const Vec2& cPos)
-				{
-					const double swing = Math::Sin(t * 8.0) * 6.0;
-					const double bodyBottom = 580.0;
-					const double bodyTop = bodyBottom - 36;
-					const double bodyCenterY = (bodyTop + bodyBottom) / 2;
-					const double faceY = bodyTop - 14;
+		// base は足元の中央。holding は手に持つ果物（-1 で手ぶら）
+		static void PaintSitting(DrawList& list, const Vec2& base, int holding)
+		{
+			const double groundY = base.y;
+			const double bodyBottom = groundY;
+			const double bodyTop = bodyBottom - 28;
+			const double bodyCenterY = (bodyTop + bodyBottom) / 2;
+			const double faceY = bodyTop - 12;
+			const Vec2 cPos = base;
+
+			// 頭（外＝毛 / 内＝顔）
+			list.add(Circle{ Vec2{ cPos.x, faceY }, 16 }, furColor);
+			list.add(Circle{ Vec2{ cPos.x, faceY + 2 }, 12 }, faceColor);
+			// 耳
+			list.add(Circle{ Vec2{ cPos.x - 16, faceY + 2 }, 6 }, furColor);
+			list.add(Circle{ Vec2{ cPos.x + 16, faceY + 2 }, 6 }, furColor);
+			// 目
+			list.add(Circle{ Vec2{ cPos.x - 4, faceY }, 2 }, eyeColor);
+			list.add(Circle{ Vec2{ cPos.x + 4, faceY }, 2 }, eyeColor);
+			// 胴体
+			list.add(RoundRect{ RectF{ Arg::center = Vec2{ cPos.x, bodyCenterY }, 30, 28 }, 6 }, furColor);
+			// 足
+			list.add(RectF{ cPos.x - 12, bodyBottom - 14, 10, 14 }, furColor);
+			list.add(RectF{ cPos.x + 2, bodyBottom - 14, 10, 14 }, furColor);
+			list.add(RoundRect{ RectF{ cPos.x - 14, groundY - 8, 10, 8 }, 2 }, furColor);
+			list.add(RoundRect{ RectF{ cPos.x + 2, groundY - 8, 10, 8 }, 2 }, furColor);
+			// しっぽ
+			{
+				const Vec2 tail = Vec2{ cPos.x + 16, bodyBottom - 16 };
+				list.add(Bezier2{ tail, tail.movedBy(10,-10), tail.movedBy(0,-20) }, 4, furColor);
+			}
+			// 腕
+			if (holding >= 0) {
+				list.add(RectF{ cPos.x - 20, faceY + 4, 6, -24 }, furColor);
+				list.add(RectF{ cPos.x + 14, faceY + 4, 6, -24 }, furColor);
+				PaintFruit(list, holding, Vec2{ cPos.x, faceY - 28 });
+			}
+			else {
+				list.add(RectF{ cPos.x - 16, bodyBottom - 20, 8, 16 }, furColor);
+				list.add(RectF{ cPos.x + 8, bodyBottom - 20, 8, 16 }, furColor);
+			}
+		}
 
-					Circle{ Vec2{ cPos.x, faceY }, 16 }.draw(furColor);
-					Circle{ Vec2{ cPos.x, faceY + 2 }, 12 }.draw(faceColor);
-					Circle{ Vec2{ cPos.x - 16, faceY + 2 }, 6 }.draw(furColor);
-					Circle{ Vec2{ cPos.x + 16, faceY + 2 }, 6 }.draw(furColor);
-					Circle{ Vec2{ cPos.x - 4, faceY }, 2 }.draw(eyeColor);
-					Circle{ Vec2{ cPos.x + 4, faceY }, 2 }.draw(eyeColor);
+		static void PaintWalking(DrawList& list, const Vec2& base, double swing)
+		{
+			const double bodyBottom = base.y;
+			const double bodyTop = bodyBottom - 36;
+			const double bodyCenterY = (bodyTop + bodyBottom) / 2;
+			const double faceY = bodyTop - 14;
+			const Vec2 cPos = base;
 
-					RoundRect{ RectF{ Arg::center = Vec2{ cPos.x, bodyCenterY }, 32, 36 }, 6 }.draw(furColor);
+			list.add(Circle{ Vec2{ cPos.x, faceY }, 16 }, furColor);
+			list.add(Circle{ Vec2{ cPos.x, faceY + 2 }, 12 }, faceColor);
+			list.add(Circle{ Vec2{ cPos.x - 16, faceY + 2 }, 6 }, furColor);
+			list.add(Circle{ Vec2{ cPos.x + 16, faceY + 2 }, 6 }, furColor);
+			list.add(Circle{ Vec2{ cPos.x - 4, faceY }, 2 }, eyeColor);
+			list.add(Circle{ Vec2{ cPos.x + 4, faceY }, 2 }, eyeColor);
 
-					RectF{ cPos.x - 22, bodyTop + 4 + swing * 0.3, 6, 20 }.draw(furColor);
-					RectF{ cPos.x + 16, bodyTop + 4 - swing * 0.3, 6, 20 }.draw(furColor);
+			list.add(RoundRect{ RectF{ Arg::center = Vec2{ cPos.x, bodyCenterY }, 32, 36 }, 6 }, furColor);
 
-					RectF{ cPos.x - 8, bodyBottom - 8 + swing * 0.5, 6, 8 }.draw(furColor);
-					RectF{ cPos.x + 2, bodyBottom - 8 - swing * 0.5, 6, 8 }.draw(furColor);
+			list.add(RectF{ cPos.x - 22, bodyTop + 4 + swing * 0.3, 6, 20 }, furColor);
+			list.add(RectF{ cPos.x + 16, bodyTop + 4 - swing * 0.3, 6, 20 }, furColor);
 
-					const Vec2 base = Vec2{ cPos.x + 18, bodyBottom - 20 + swing * 0.2 };
-					Bezier2{ base, base.movedBy(10,-12), base.movedBy(0,-28) }.draw(4, furColor);
-				};
+			list.add(RectF{ cPos.x - 8, bodyBottom - 8 + swing * 0.5, 6, 8 }, furColor);
+			list.add(RectF{ cPos.x + 2, bodyBottom - 8 - swing * 0.5, 6, 8 }, furColor);
 
-			if (phase == Phase::Entering || phase == Phase::Leaving) {
-				drawWalking(pos);
-			}
-			else {
-				const bool holdingFruit = (phase == Phase::Eating);
-				drawSitting(pos, holdingFruit);
-			}
+			const Vec2 tail = Vec2{ cPos.x + 18, bodyBottom - 20 + swing * 0.2 };
+			list.add(Bezier2{ tail, tail.movedBy(10,-12), tail.movedBy(0,-28) }, 4, furColor);
 		}
+# endif
 	};
 
 	Monkey monkey;
 
 	// ---- 謎解き：木に生る果物の並び ----
 	Array<int> fruits{ 0, 1, 2, 3 };
-	const Array<int> answer{ 0, 1, 2, 3 };
+	Array<int> answer{ 0, 1, 2, 3 };
 	Array<Vec2> fruitSlots;
 
 	// ---- ジャンプ踏みスイッチ ----
@@ -773,11 +1573,30 @@ private:
 	double clearT = 0.0;
 	const double fadeOutSec = 0.7;
 
-	static void drawPad(const RectF& r, bool pressed) {
-		const ColorF base = pressed ? ColorF{ 0.65,0.7,0.75 } : ColorF{ 0.8,0.85,0.9 };
-		r.draw(base);
-		r.drawFrame(2, 0, ColorF{ 0.22,0.26,0.3,0.8 });
-		r.stretched(-6, -8).drawFrame(2, 0, ColorF{ 0.22,0.26,0.3,0.25 });
+	explicit Stage1Sim(uint64 seed = 0, const SimLoad& load = {}) {
+		platforms = { RectF{ 0, 580, 960, 60 }, };
+		colliders = MakeLevelColliders(sceneSize, platforms);
+		player.snapTo(Vec2{ 80, 540 });
+
+		const int32 count = Max(load.fruits, 2);
+		answer.resize(count);
+		std::iota(answer.begin(), answer.end(), 0);
+		fruits = answer;
+
+		const double cx = sceneSize.x * 0.5;
+		const double y = 210;
+		const double step = 48;
+		for (int32 i = 0; i < count; ++i) {
+			fruitSlots << Vec2{ cx + (i - (count - 1) * 0.5) * step, y };
+		}
+
+		// スイッチ（中央付近）
+		swSwap = RectF{ 420, 560, 48, 20 };
+		swRotate = RectF{ 500, 560, 48, 20 };
+
+		// 初期配置をランダム（正解と一致しないまでシャッフル）
+		SimRng rng{ seed };
+		do { rng.shuffle(fruits); } while (fruits == answer);
 	}
 
 	bool landedOn(const RectF& r) const {
@@ -790,303 +1609,133 @@ private:
 		return (prevBottom <= r.y) && (nowBottom >= r.y) && goingDown && horizontal;
 	}
 
-public:
-	using StageBase::StageBase;
+protected:
+	void tick(const PlayerInput& in, double dt) override
+	{
+		if (!clearing) {
+			StageSim::tick(in, dt);
+		}
+		else {
+			player.vel = Vec2{ 0,0 };
+		}
 
-	Stage1(const InitData& init) : StageBase(init) {
-		platforms = { RectF{ 0, 580, 960, 60 }, };
-		colliders = MakeLevelColliders(sceneSize, platforms);
-		player = Player{}; player.pos = Vec2{ 80, 540 };
+		monkey.startIfTriggered(player.pos, events);
+		monkey.update(dt, events);
 
-		const double cx = sceneSize.x * 0.5;
-		const double y = 210;
-		const double step = 48;
-		fruitSlots = {
-			Vec2{ cx - 1.5 * step, y },
-			Vec2{ cx - 0.5 * step, y },
-			Vec2{ cx + 0.5 * step, y },
-			Vec2{ cx + 1.5 * step, y },
+		if (fadeInAlpha > 0.0) {
+			fadeInAlpha = Max(0.0, fadeInAlpha - dt / fadeInSec);
+		}
 
-		};
+		if (clearing) {
+			clearT += dt;
+			if (clearT >= fadeOutSec) {
+				finish();
+				return;
+			}
+		}
 
-		// SE
-		AudioAsset::Register(U"clearSE", U"Assets/clearSE.mp3");
-		AudioAsset(U"clearSE").setVolume(0.9);
-		AudioAsset::Register(U"doorSE", U"Assets/doorSE.mp3");
-		AudioAsset::Register(U"monkeySE", U"Assets/monkeySE.mp3");
-		AudioAsset(U"monkeySE").setVolume(0.4);
-		AudioAsset::Register(U"buttonSE", U"Assets/buttonSE.mp3");
-		AudioAsset(U"buttonSE").setVolume(1.4);
+		// クリア前のみパズル操作を有効
+		if (!clearing) {
+			// 踏み検出（ジャンプで上から着地した瞬間のみ反応）
+			const bool pressSwap = landedOn(swSwap);
+			const bool pressRotate = landedOn(swRotate);
 
-		// BGM 
-		AudioAsset::Register(U"stage1BGM", U"Assets/stage1BGM.mp3");
-		AudioAsset(U"stage1BGM").setLoop(true);
-		AudioAsset(U"stage1BGM").setVolume(0.15);
-		AudioAsset(U"stage1BGM").play();
+			if (pressSwap && !swSwapPrev) {
+				emit(SimEvent::PlayButton);
+				std::swap(fruits.front(), fruits.back()); // 端同士スワップ
+			}
+			if (pressRotate && !swRotatePrev) {
+				emit(SimEvent::PlayButton);
+				const size_t count = fruits.size();
+				auto next = makeScratch<int>(count);
+				for (size_t i = 0; i < count; ++i) {
+					next[(i + 1) % count] = fruits[i];  // 右に1つずらす
+				}
+				fruits.assign(next.begin(), next.end());
+			}
+			swSwapPrev = pressSwap;
+			swRotatePrev = pressRotate;
 
+			// 正解になった瞬間に扉「出現」
+			if (!doorAppeared && (fruits == answer)) {
+				doorAppeared = true;
+				emit(SimEvent::PlayDoor);
+			}
 
-		// スイッチ（中央付近）
-		swSwap = RectF{ 420, 560, 48, 20 };
-		swRotate = RectF{ 500, 560, 48, 20 };
+			// 出現済みの扉に触れたら → SE 再生＋フェードアウト開始
+			if (doorAppeared && RectF{ player.pos, player.size }.intersects(door)) {
+				clearing = true;
+				clearT = 0.0;
+				emit(SimEvent::PlayClear);
+				emit(SimEvent::StopStage1BGM);
+			}
+		}
+	}
+};
 
-		// 初期配置をランダム（正解と一致しないまでシャッフル）
-		do { Shuffle(fruits); } while (fruits == answer);
+//============================= Stage2（心臓） =============================
+struct Stage2Sim : StageSim {
+	static constexpr int32 StageId = 2;
 
-		doorAppeared = false;
+	// --- 拍同期 ---
+	double heartHz = 1.1;     // 背景・判定・SFX すべてこの周波数
+	double t0 = 0.0;          // シーン開始時刻（基準）
+	static constexpr double peakPhase = 0.25;
 
-		// フェードイン開始状態
-		fadeInAlpha = 1.0;
-		clearing = false;
-		clearT = 0.0;
-	}
+	// 連打ゲージ
+	int combo = 0;
+	static constexpr int kGoalCombo = 10;
 
+	RectF door{ 40, 500, 60, 80 };
+	bool  doorAppeared = false;
+	bool  doorSEPlayed = false;
+	bool  heartStarted = false;
 
-	// --- 背景（森＋象徴の木＋横一列の木の実） ---
-	void drawBackground() const override {
-		const double groundLineY = 560.0;
-
-		RectF{ 0,0,(double)sceneSize.x,(double)sceneSize.y }
-		.draw(Arg::top = ColorF{ 0.88,0.95,1.0 }, Arg::bottom = ColorF{ 0.82,0.93,0.86 });
-
-		// 奥の森
-		{
-			const ColorF farTree{ 0.45,0.55,0.45,0.35 };
-			for (int i = 0; i < 14; ++i) {
-				const double bx = (i * 80.0) + (i % 3 * 12.0);
-				const double cy = 140.0 + (i % 4 * 8.0);
-				Circle{ bx + 38, cy + 0, 70 }.draw(farTree);
-				Circle{ bx + 14, cy + 20, 60 }.draw(farTree);
-				Circle{ bx + 60, cy + 28, 58 }.draw(farTree);
-				RectF{ bx + 30, cy + 40, 24, groundLineY - (cy + 40) }.draw(farTree);
-			}
-		}
-		// 手前の森（薄め）
-		{
-			const ColorF nearTree{ 0.35,0.45,0.35,0.4 };
-			for (int i = 0; i < 10; ++i) {
-				const double bx = (i * 110.0) + ((i % 2) * 25.0);
-				const double cy = 100.0 + (i % 3 * 10.0);
-				Circle{ bx + 38, cy - 20, 90 }.draw(nearTree);
-				Circle{ bx + 8, cy + 10, 75 }.draw(nearTree);
-				Circle{ bx + 70, cy + 18, 70 }.draw(nearTree);
-				RectF{ bx + 28, cy + 30, 24, groundLineY - (cy + 30) }.draw(nearTree);
-			}
-		}
-
-		// 象徴の木
-		{
-			const double cx = sceneSize.x * 0.5;
-			const double crownBaseY = 180.0;
-			const double trunkW = 48.0;
-			const ColorF leaf{ 0.16,0.24,0.16,0.8 }, trunk{ 0.10,0.16,0.10,0.85 };
-
-			Circle{ Vec2{cx - 60,crownBaseY + 20},70 }.draw(leaf);
-			Circle{ Vec2{cx + 60,crownBaseY + 20},70 }.draw(leaf);
-			Circle{ Vec2{cx,   crownBaseY - 10},80 }.draw(leaf);
-			Circle{ Vec2{cx - 90,crownBaseY + 50},60 }.draw(leaf);
-			Circle{ Vec2{cx + 90,crownBaseY + 50},60 }.draw(leaf);
-
-			const double tTop = crownBaseY + 40, tBot = 560;
-			RectF{ cx - trunkW * 0.5, tTop, trunkW, tBot - tTop }.draw(trunk);
-			Circle{ Vec2{ cx - trunkW * 0.7, tTop + 20 }, 30 }.draw(leaf);
-			Circle{ Vec2{ cx + trunkW * 0.7, tTop + 20 }, 30 }.draw(leaf);
-		}
-
-		// 木の実（横一列）
-		for (size_t i = 0; i < fruits.size(); ++i) {
-			Monkey::DrawFruit(fruits[i], fruitSlots[i]);
-		}
-
-		// 地面帯＋薄霧
-		RectF{ 0, groundLineY, sceneSize.x, (double)sceneSize.y - groundLineY }.draw(ColorF{ 0.06,0.08,0.06,0.8 });
-		RectF{ 0, 0, sceneSize.x, sceneSize.y }.draw(ColorF{ 1,1,1,0.04 });
-	}
-
-	// --- 更新 ---
-	void update() override
-	{
-		const double dt = Scene::DeltaTime();
-
-		if (!clearing) {
-			player.update(colliders);
-			player.advanceAnim();
-		}
-		else {
-			player.vel = Vec2{ 0,0 };
-		}
-
-		monkey.startIfTriggered(player.pos);
-		monkey.update(dt);
-
-		if (fadeInAlpha > 0.0) {
-			fadeInAlpha = Max(0.0, fadeInAlpha - dt / fadeInSec);
-		}
-
-		if (clearing) {
-			clearT += dt;
-			if (clearT >= fadeOutSec) {
-				getData().unlocked = Max(getData().unlocked, 2);
-				TextWriter writer{ U"Assets/SaveData.txt" };
-				if (writer)
-				{
-					writer.writeln(Format(getData().unlocked));
-				}
-				writer.close();
-				StopAllAudio();
-				changeScene(State::Stage2, 0s);
-				return;
-			}
-		}
-
-		// クリア前のみパズル操作を有効
-		if (!clearing) {
-			// 踏み検出（ジャンプで上から着地した瞬間のみ反応）
-			const bool pressSwap = landedOn(swSwap);
-			const bool pressRotate = landedOn(swRotate);
-
-			if (pressSwap && !swSwapPrev) {
-				AudioAsset(U"buttonSE").play();
-				std::swap(fruits[0], fruits[3]); // 端同士スワップ
-			}
-			if (pressRotate && !swRotatePrev) {
-				AudioAsset(U"buttonSE").play();
-				Array<int> next(4);
-				for (int i = 0; i < 4; ++i) {
-					next[(i + 1) % 4] = fruits[i];  // 右に1つずらす
-				}
-				fruits = next;
-			}
-			swSwapPrev = pressSwap;
-			swRotatePrev = pressRotate;
-
-			// 正解になった瞬間に扉「出現」
-			if (!doorAppeared && (fruits == answer)) {
-				doorAppeared = true;
-				AudioAsset(U"doorSE").play();
-			}
-
-			// 出現済みの扉に触れたら → SE 再生＋フェードアウト開始
-			if (doorAppeared && RectF{ player.pos, player.size }.intersects(door)) {
-				clearing = true;
-				clearT = 0.0;
-				AudioAsset(U"clearSE").play();
-				AudioAsset(U"stage1BGM").stop();
-			}
-		}
-
-		if (!clearing && KeyEscape.down()) {
-			AudioAsset(U"monkeySE").stop();
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
-		}
-	}
-
-
-	// --- 描画（レイヤー順：背景 → 地面 → サル（奥） → パッド/扉 → プレイヤー（手前）） ---
-	void draw() const override
-	{
-		drawBackground();
-		drawLevel();
-		monkey.draw();
-
-		drawPad(swSwap, swSwapPrev);
-		drawPad(swRotate, swRotatePrev);
-
-		if (doorAppeared) {
-			door.draw(Palette::White);
-			door.drawFrame(4, 0, ColorF{ 0.15,0.5,0.25 });
-			RectF{ door.x + 6, door.y + 6, door.w - 12, door.h - 12 }.draw(ColorF{ 0.85,1.0,0.9,0.35 });
-		}
-
-		player.draw();
+	explicit Stage2Sim(uint64 = 0, const SimLoad& = {}) {
+		platforms = { RectF{ 0, 580, 960, 60 }, };
+		colliders = MakeLevelColliders(sceneSize, platforms);
+		player.snapTo(Vec2{ 60, 540 });
 
-		if (fadeInAlpha > 0.0) {
-			RectF{ 0,0, (double)sceneSize.x, (double)sceneSize.y }.draw(ColorF{ 0,0,0, fadeInAlpha });
-		}
-		if (clearing) {
-			const double a = Saturate(clearT / fadeOutSec);
-			RectF{ 0,0, (double)sceneSize.x, (double)sceneSize.y }.draw(ColorF{ 0,0,0, a });
-		}
+		t0 = simTime;
 	}
 
-	void onClear() override {}
-};
-
-
-//----------------------------- Stage2 -----------------------------
-class Stage2 : public StageBase {
-public:
-	using StageBase::StageBase;
-
-private:
-	// --- 拍同期 ---
-	double heartHz = 1.1;     // 背景・判定・SFX すべてこの周波数
-	double t0 = 0.0;          // シーン開始時刻（基準）
-	static constexpr double peakPhase = 0.25;
-
-	// 連打ゲージ
-	int combo = 0;
-	static constexpr int kGoalCombo = 10;
-
-	RectF door{ 40, 500, 60, 80 };
-	bool  doorAppeared = false;
-
 	// --- 拍ユーティリティ ---
-	double beatTime() const { return (Scene::Time() - t0); }
+	double beatTime() const { return (simTime - t0); }
 	double period() const { return 1.0 / heartHz; }
 	double phase()  const {
 		double cyc = beatTime() * heartHz;
 		return (cyc - Math::Floor(cyc));
 	}
-	double beatEnvelope() const {
-		return (Math::Sin(Math::TwoPi * heartHz * beatTime()) * 0.5 + 0.5);
-	}
-	bool justHitPeakThisFrame() const {
-		const double p = period();
-		const double a = beatTime() - p * peakPhase;
-		const double b = a - Scene::DeltaTime();
-		const int nA = (int)Math::Floor(a / p + 0.5);
-		const int nB = (int)Math::Floor(b / p + 0.5);
-		return (nA != nB);
+	// 描画用。t は beatTime と同じ基準の時刻（実機では音の再生位置から出した時計）
+	double beatEnvelope(double t) const {
+		return (Math::Sin(Math::TwoPi * heartHz * t) * 0.5 + 0.5);
 	}
-	bool isOnBeatFrames(int frames) const {
+	// 1拍の中で鼓動の音が鳴る時刻（beatTime を period で割った余り）
+	double heartbeatOffset() const { return period() * (peakPhase + 0.5); }
+	// 判定幅（片側）。以前の「60fps 換算で 20 フレーム」と同じ
+	static constexpr double kHitWindow = 20.0 / 60.0;
+	// 鼓動が鳴ってから押すまでの遅れ。未測定なら調整済みの既定値（判定の中心が従来と同じになる）
+	double judgeLatency() const { return (inputLatency >= 0.0) ? inputLatency : (0.5 - period() * 0.5); }
+	// 押した時刻 t（beatTime 基準）が拍に合っているか
+	bool isOnBeatAt(double t) const {
 		const double p = period();
-		const double x = beatTime() - 0.5 - p * peakPhase;
+		const double x = t - judgeLatency() - heartbeatOffset();
 		const double nearest = p * Math::Round(x / p);
-		const double tol = frames * Scene::DeltaTime();
-		return (Abs(x - nearest) <= tol);
-	}
-	bool doorSEPlayed = false;
-
-public:
-	Stage2(const InitData& init) : StageBase(init) {
-		platforms = { RectF{ 0, 580, 960, 60 }, };
-		colliders = MakeLevelColliders(sceneSize, platforms);
-		player = Player{}; player.pos = Vec2{ 60, 540 };
-
-		doorAppeared = false;
-		combo = 0;
-
-		t0 = Scene::Time();
-		AudioAsset::Register(U"heartbeat", U"Assets/heartbeats.mp3");
-		AudioAsset(U"heartbeat").setVolume(0.8);
-		AudioAsset::Register(U"clearSE", U"Assets/clearSE.mp3");
-		AudioAsset(U"clear").setVolume(0.9);
-		AudioAsset::Register(U"doorSE", U"Assets/doorSE.mp3");
+		return (Abs(x - nearest) <= kHitWindow);
 	}
 
+protected:
+	void tick(const PlayerInput& in, double dt) override {
+		StageSim::tick(in, dt);
 
-	void update() override {
-		StageBase::update();
-
-
-		if (justHitPeakThisFrame()) {
-			if (!doorSEPlayed)
-				AudioAsset(U"heartbeat").play();
+		if (!heartStarted) {
+			heartStarted = true;
+			emit(SimEvent::StartHeartbeat);
 		}
 
 		if (player.jumpedThisFrame) {
-			if (isOnBeatFrames(20)) {
+			const double pressedAt = beatTime() + in.jumpSub * (dt / 16.0);
+			if (isOnBeatAt(pressedAt)) {
 				combo = Min(combo + 1, kGoalCombo);
 				if (combo >= kGoalCombo) doorAppeared = true;
 			}
@@ -1095,101 +1744,105 @@ public:
 			}
 		}
 		if (doorAppeared && !doorSEPlayed) {
-			AudioAsset(U"heartbeat").stop();
-			AudioAsset(U"doorSE").play();
+			emit(SimEvent::StopHeartbeat);
+			emit(SimEvent::PlayDoor);
 			doorSEPlayed = true;
 		}
 
 		if (doorAppeared && RectF{ player.pos, player.size }.intersects(door)) {
-			onClear();
+			emit(SimEvent::PlayClear);
+			finish();
 		}
 	}
+};
 
+// 1拍ぶんの音をループ再生しているときの再生位置から、拍の時計（beatTime と同じ基準）を作る。
+// 再生位置はミキサーのバッファ単位でしか進まない（位置から出した時刻は本当の時刻の下限になる）ので、
+// 時計はフレームの経過時間で進め、下限より遅れたときだけ追いつかせる
+class BeatClock {
+public:
+	// 再生位置 0 が拍の時刻 origin に当たる。rate はサンプルレート、length は1周のサンプル数
+	void start(const double origin_, const uint32 rate_, const size_t length_) {
+		origin = origin_;
+		rate = (double)Max<uint32>(rate_, 1);
+		length = Max<size_t>(length_, 1);
+		loopSec = (double)length / rate;
+		clock = origin_;
+	}
 
-	// 心臓
-	void drawBackground() const override
-	{
-		RectF{ 0,0,(double)sceneSize.x,(double)sceneSize.y }
-		.draw(Arg::top = ColorF{ 0.92,0.96,1.0 }, Arg::bottom = ColorF{ 1.0,0.92,0.96 });
-
-		const double beat = beatEnvelope();
-		const double scale = 1.0 + 0.03 * beat;
-
-		const Vec2   C = Vec2{ sceneSize.x * 0.5, sceneSize.y * 0.48 };
-		const double S = 170.0 * scale;
-
-		Ellipse{ C.movedBy(10, 18), 140 * scale, 46 * scale }.draw(ColorF{ 0,0,0,0.08 });
-
-		const Polygon heart = Shape2D::Heart(S, C);
-		heart.draw(ColorF{ 0.90, 0.25, 0.35 });
-		heart.scaledAt(C, 0.92).draw(ColorF{ 0.85, 0.18, 0.30, 0.9 });
-		heart.drawFrame(4, ColorF{ 0.70, 0.10, 0.20, 0.35 });
+	// 前回から dt 秒たち、再生位置が pos（サンプル）になった
+	void update(const double dt, const int64 pos) {
+		clock += dt;
+		// 何周目かは経過時間から決める（位置の巻き戻りを数えると、1周より長く止まったときに周を数え落とす）
+		const double posSec = (double)pos / rate;
+		const double loops = Math::Round((clock - origin - posSec) / loopSec);
+		const double measured = origin + loops * loopSec + posSec;
+		sampled = measured;
+		const double err = measured - clock;
+		if (Abs(err) > kSnap || err > 0.0) clock = measured;   // 止まった後・下限より遅れた
+
+		// 音より速く進みすぎた分：下限からの先行は位置が更新された直後に一番小さくなるので、
+		// しばらくの間の最小値が正なら、時計はその分だけ確実に先へ行っている。半分ずつ戻す
+		minLead = Min(minLead, clock - measured);
+		if (++leadFrames >= kLeadWindow) {
+			if (minLead > 0.0) clock -= minLead * 0.5;
+			minLead = kSnap;
+			leadFrames = 0;
+		}
+	}
 
-		const double a = 0.20 + 0.10 * beat;
-		Ellipse{ C.movedBy(-S * 0.25, -S * 0.20), S * 0.55, S * 0.38 }.draw(ColorF{ 1.0, 0.95, 0.98, a * 0.7 });
-		Ellipse{ C.movedBy(-S * 0.10, -S * 0.30), S * 0.25, S * 0.18 }.draw(ColorF{ 1.0, 1.0, 1.0, a * 0.35 });
+	// 音が鳴っていない間などに、時計を t に合わせる
+	void set(const double t) { clock = t; }
 
-		const ColorF tube{ 0.75, 0.18, 0.28, 0.7 };
+	// 拍の時刻 t に当たる再生位置（サンプル）。ここへ seek して set(t) すると音と時計がそろう
+	size_t positionAt(const double t) const {
+		const double x = (t - origin) / loopSec;
+		return Min((size_t)((x - Math::Floor(x)) * (double)length), length - 1);
+	}
 
-		Bezier2{ C.movedBy(-S * 0.08, -S * 0.55), C.movedBy(-S * 0.22, -S * 0.68), C.movedBy(-S * 0.35, -S * 0.50) }.draw(10, tube);
-		Bezier2{ C.movedBy(S * 0.05, -S * 0.55), C.movedBy(S * 0.22, -S * 0.70), C.movedBy(S * 0.34, -S * 0.56) }.draw(8, tube);
+	double time() const { return clock; }
+	// 直前の update で再生位置から出した時刻（ミキサーのバッファ単位）
+	double sampleTime() const { return sampled; }
 
-		heart.drawFrame(14, ColorF{ 1.0, 0.6, 0.7, 0.06 });
-	}
+	// これ以上ずれていたら寄せずに再生位置の値へ飛ぶ
+	static constexpr double kSnap = 0.05;
+	// 先行の最小値を見るフレーム数（この間に再生位置が何度か更新されること）
+	static constexpr int32 kLeadWindow = 30;
 
+private:
+	double origin = 0.0;
+	double rate = 1.0;
+	double loopSec = 1.0;
+	size_t length = 1;
+	double clock = 0.0;
+	double sampled = 0.0;
+	double minLead = kSnap;
+	int32  leadFrames = 0;
+};
 
-	// 描画順：背景（心臓）→ 地面 → ゴール → プレイヤー
-	void draw() const override {
-		drawBackground();
-		drawLevel();
+// ずれ（µs）の平均・揺れ（標準偏差）・最大
+struct OffsetStats {
+	double sum = 0.0, sq = 0.0, max = 0.0;
+	size_t n = 0;
 
-		// --- リズムゲージ ---
-		{
-			const Vec2 base = Vec2{ Scene::CenterF().x - 200, 24 };
-			const double w = 36, h = 10, gap = 6;
-			for (int i = 0; i < kGoalCombo; ++i) {
-				const RectF r{ base.x + i * (w + gap), base.y, w, h };
-				if (i < combo) {
-					r.stretched(0, 2).draw(ColorF{ 0.9, 0.2, 0.3, 0.9 });
-				}
-				else {
-					r.draw(ColorF{ 0.92, 0.92, 0.95, 0.7 });
-					r.drawFrame(1.5, ColorF{ 0.5, 0.5, 0.6, 0.6 });
-				}
-			}
-			const double t = Scene::Time();
-			const double p = (t * heartHz) - Math::Floor(t * heartHz);
-			const double x = base.x + (w + gap) * (kGoalCombo * Math::Clamp(p, 0.0, 1.0));
-			Line{ x, base.y - 6, x, base.y + h + 6 }.draw(2, ColorF{ 0.8,0.3,0.4,0.25 });
-		}
-		if (doorAppeared) {
-			door.drawFrame(4, ColorF{ 0.15,0.5,0.25 });
-			RectF{ door.x + 6, door.y + 6, door.w - 12, door.h - 12 }
-			.draw(ColorF{ 0.85,1.0,0.9,0.35 });
-		}
-		player.draw();
+	void add(const double us) {
+		sum += us;
+		sq += us * us;
+		max = Max(max, Abs(us));
+		++n;
 	}
-
-	void onClear() override {
-		AudioAsset(U"clearSE").play();
-		getData().unlocked = Max(getData().unlocked, 3);
-		TextWriter writer{ U"Assets/SaveData.txt" };
-		if (writer)
-		{
-			writer.writeln(Format(getData().unlocked));
-		}
-		writer.close();
-		StopAllAudio();
-		changeScene(State::Stage3, 0.5s);
+	double mean() const { return (n ? sum / n : 0.0); }
+	double jitter() const {
+		if (n == 0) return 0.0;
+		const double m = mean();
+		return Math::Sqrt(Max(0.0, sq / n - m * m));
 	}
 };
 
-//----------------------------- Stage3 -----------------------------
-class Stage3 : public StageBase {
-public:
-	using StageBase::StageBase;
+//============================= Stage3（シャー芯） =============================
+struct Stage3Sim : StageSim {
+	static constexpr int32 StageId = 3;
 
-private:
 	// ===== シャーペン =====
 	struct PencilBridge {
 		Vec2   origin;              // 左端（床yは origin.y）
@@ -1244,6 +1897,7 @@ private:
 			else if (impact > 200) hp = Max(0, hp - 1);
 		}
 
+# if !SINLAND_HEADLESS
 		// 描画（本体固定＋口金＋細い芯＋ノック）
 		void draw() const {
 			const double y = origin.y - H * 0.5;
@@ -1278,43 +1932,12 @@ private:
 			if (hp <= 2) Line{ origin.movedBy(18, y + 6), Vec2{ origin.x + bodyWidth() - 18, y + 12 } }.draw(2, ColorF{ 0,0,0,0.35 });
 			if (hp <= 1) Line{ origin.movedBy(30, y + 14), Vec2{ origin.x + bodyWidth() - 28, y + 4 } }.draw(2, ColorF{ 0,0,0,0.45 });
 		}
+# endif
 	};
 
-	// ===== 折れた芯（落下アニメ用） =====
-	struct LeadFragment {
-		Vec2 pos;
-		double w, h;
-		Vec2 vel;
-		double angle = 0.0;   // 傾き角度（固定）
-		bool active = false;
-
-		void init(const RectF& srcRect) {
-			// 少し太く＆わずかに右にずらしてスタート
-			pos = srcRect.pos.movedBy(0, -1);     // わずかに上補正
-			w = srcRect.w;
-			h = srcRect.h * 0.8;
-			vel = Vec2{ Random(60.0, 90.0), -50 }; // 右方向に初速
-			angle = Random(6_deg, 14_deg);         // 少し右に傾く固定角
-			active = true;
-		}
-
-		void update(double dt) {
-			if (!active) return;
-			vel.y += 980 * dt;     // 重力
-			pos += vel * dt;
-			if (pos.y > Scene::Height() + 100) active = false;
-		}
-
-		void draw() const {
-			if (!active) return;
-			RectF{ pos, w, h }
-				.rotated(angle)
-				.draw(ColorF{ 0.1, 0.1, 0.12, 0.95 });
-		}
-	};
-
-
-	LeadFragment brokenLead;
+	// ===== 折れた芯（落下アニメ用）。続けて折っても前の破片は落ち切るまで残る =====
+	ParticlePool brokenLeads{ 8, ParticlePool::Params{
+		.shape = ParticlePool::Shape::Rect, .gravity = 980.0f, .killY = (float)(sceneSize.y + 100.0) } };
 
 
 	// ===== ステージ要素 =====
@@ -1324,7 +1947,7 @@ private:
 
 	// ノック部ボタン
 	RectF        button;
-	Stopwatch    buttonCD{ StartImmediately::No };
+	double       buttonSince = 1e9;     // 前回押下からの経過（sim 時間）
 	double       buttonCooldown = 0.20;
 	bool         buttonPrevOverlap = false;
 
@@ -1339,6 +1962,9 @@ private:
 	// 状態
 	bool wasOnLead = false;
 
+	// 動的コライダ（colliders 内のハンドル）
+	ColliderGrid::Handle bodyHandle = 0, leadHandle = 0, buttonHandle = 0;
+
 	// “ジャンプからの着地のみ”を拾う（水平移動で乗っただけは false）
 	bool landedFromJumpOn(const RectF& r) const {
 		const double eps = 1.0; // 解決誤差許容
@@ -1352,602 +1978,2593 @@ private:
 		return crossed && goingDown && horiz && (dy > 0.5) && fallEnough;
 	}
 
-	// 芯を折る
-	void breakLead() {
-		AudioAsset(U"BreakSE").play();
-		// 現在の芯の矩形をコピーして破片に
-		const RectF leadRect = pencil.colliderLead();
-		if (leadRect.w > 0) {
-			brokenLead.init(leadRect);
+	SimRng rng;
+
+	int32 fragments = 1;   // 1回折れたときの破片の数
+
+	explicit Stage3Sim(uint64 seed = 0, const SimLoad& load = {}) : rng{ seed } {
+		const double groundY = 560.0;
+
+		fragments = Max(load.leadFragments, 1);
+		if (fragments > 1) brokenLeads.setCapacity(8 * (size_t)fragments);
+
+		// スタート島（シャーペン本体は固定長）
+		pencil.origin = Vec2{ 60, groundY };
+		pencil.bodyLen = 160;
+		pencil.leadStep = 80;
+		pencil.maxLead = 560;
+
+		// ドア島（幅=80）
+		doorPad = RectF{ 770, groundY, 80, 14 };
+		door = RectF{ doorPad.centerX() - 30, doorPad.y - 80, 60, 80 };
+
+		// 固定床（ドア島のみ）※ペンは動的コライダで追加
+		platforms = { doorPad };
+		colliders = MakeLevelColliders(sceneSize, platforms);
+
+		// プレイヤー初期位置（少し右にシフト）
+		startPos = Vec2{ pencil.origin.x + 24, pencil.origin.y - player.size.y }; // ← +24 に
+		player.snapTo(startPos);
+
+		// ボタン：ノック（push）部分の上に配置
+		{
+			const RectF cap = pencil.capRect();
+			button = RectF{ cap.centerX() - 12, cap.y - 8, 24, 6 };
+		}
+
+		// ペン本体・芯・ボタンは動的コライダとして追加（芯は tick ごとに差し替え）
+		bodyHandle = colliders.insert(pencil.colliderBody());
+		leadHandle = colliders.insert(pencil.colliderLead());
+		buttonHandle = colliders.insert(button);
+		{
+			RectF full = pencil.colliderLead();
+			full.w = pencil.maxLead;
+			colliders.reserve(full);
+		}
+	}
+
+protected:
+	// 芯を折る
+	void breakLead() {
+		emit(SimEvent::PlayBreak);
+		// 現在の芯の矩形をコピーして破片に
+		const RectF leadRect = pencil.colliderLead();
+		if (leadRect.w > 0) {
+			// わずかに上から、右へ初速をつけて少し右に傾けたまま落とす（fragments 本に等分）
+			const double w = leadRect.w / fragments;
+			brokenLeads.emitBurst((size_t)fragments, [&](size_t i) {
+				ParticlePool::Spawn frag;
+				frag.pos = Vec2{ leadRect.x + w * i, leadRect.y - 1 };
+				frag.size = w;
+				frag.height = leadRect.h * 0.8;
+				frag.vel = Vec2{ rng.uniform(60.0, 90.0), -50 };
+				frag.angle = rng.uniform(6_deg, 14_deg);
+				return frag;
+			});
+		}
+
+		pencil.reset();               // 芯を消す（長さ0に戻す）
+		buttonPrevOverlap = false;    // ボタン再押下を確実に
+		wasOnLead = false;
+	}
+
+	void tick(const PlayerInput& in, double dt) override {
+		// 先頭で芯のコライダを最新に → player.update に渡す
+		colliders.update(leadHandle, pencil.colliderLead());
+
+		StageSim::tick(in, dt);
+		// === 折れた芯の落下更新 ===
+		brokenLeads.update(dt);
+
+
+		// ---- ボタン押下（交差開始 or 着地）＋クールダウン ----
+		const RectF playerAABB{ player.pos, player.size };   // ← ここで1回だけ定義
+		const bool  overlapNow = playerAABB.intersects(button.stretched(1));
+		const bool  enteredNow = (overlapNow && !buttonPrevOverlap);
+		const bool  landedBtn = landedFromJumpOn(button);   // ボタンは“着地”でもOK
+		buttonSince += dt;
+		if ((enteredNow || landedBtn) && buttonSince >= buttonCooldown)
+		{
+			if (pencil.extendOnce()) {
+				emit(SimEvent::PlayPush);
+			}
+			buttonSince = 0.0;
+		}
+		buttonPrevOverlap = overlapNow;
+
+		// ---- 最新コライダ（延長後に更新）----
+		const RectF colBody = pencil.colliderBody();
+		const RectF colLead = pencil.colliderLead();
+
+		// === 折れる判定 ===
+		const double screenMidX = sceneSize.x * 0.5;  // 画面右半分しきい
+		const double nowCenterX = player.pos.x + player.size.x * 0.5;
+
+		// 足元（接地/立っている判定用）← ここで1回だけ定義して以降も再利用
+		const RectF feet{ player.pos.x, player.pos.y + player.size.y - 2, (double)player.size.x, 4 };
+
+		// 条件1: 芯に“ジャンプから着地” → 折れる（根元の安全帯は除外）
+		if (landedFromJumpOn(colLead)) {
+			const double safeX = colLead.x + leadRootSafeLen;
+			if (nowCenterX >= safeX) {
+				breakLead();
+				goto AFTER_BREAK_CHECKS;
+			}
+		}
+
+		// 条件3: プッシュ6回以上 & 画面右半分に到達 & grounded & 芯に“立っている” → 折れる
+		if (pencil.presses >= 6) {
+			const bool onLeadNowFeet = feet.intersects(colLead.stretched(0, 1));
+			const bool inRightHalfOfScreen = (nowCenterX >= screenMidX);
+			if (onLeadNowFeet && player.grounded && inRightHalfOfScreen) {
+				breakLead();
+				goto AFTER_BREAK_CHECKS;
+			}
+		}
+
+	AFTER_BREAK_CHECKS:;
+
+		// 衝撃演出（本体or芯上）
+		if (colBody.intersects(feet) || pencil.colliderLead().intersects(feet)) {
+			pencil.applyImpact(player.vel.y);
+		}
+
+		// 落下でリスポーン＆芯リセット
+		if (player.pos.y > sceneSize.y + 40) {
+			player.snapTo(startPos);
+			player.vel = Vec2{ 0, 0 };
+			pencil.reset();
+			buttonPrevOverlap = false;
+			wasOnLead = false;
+		}
+
+		// クリア
+		if (RectF{ player.pos, player.size }.intersects(door)) {
+			emit(SimEvent::PlayClear);
+			finish();
+		}
+	}
+};
+
+//============================= 遠近投影（Stage4 の道路） =============================
+// 道路の左右端は画面 y の一次式。係数は画面サイズが変わったときだけ求め直す
+class RoadProjection {
+public:
+	static constexpr double roadYBottom = 580.0;
+	static constexpr double roadYTop = 360.0;
+
+	static constexpr double walkLeft = 220.0;
+	static constexpr double walkRight = 70.0;
+
+	static constexpr double topScale = 0.42;
+
+	RoadProjection() = default;
+	explicit RoadProjection(const Size& view) { resize(view); }
+
+	void resize(const Size& view) {
+		w = (double)view.x;
+		h = (double)view.y;
+
+		const double vanishCX = w * 0.54;
+		leftBottom = walkLeft;
+		rightBottom = w - walkRight;
+
+		const double topHalf = ((rightBottom - leftBottom) * topScale) * 0.5;
+		leftTop = vanishCX - topHalf;
+		rightTop = vanishCX + topHalf;
+
+		// edge(y) = top + (bottom - top) * (y - roadYTop) / (roadYBottom - roadYTop)
+		leftSlope = (leftBottom - leftTop) * kInvSpan;
+		rightSlope = (rightBottom - rightTop) * kInvSpan;
+		leftAt0 = leftTop - leftSlope * roadYTop;
+		rightAt0 = rightTop - rightSlope * roadYTop;
+	}
+
+	double W() const { return w; }
+	double H() const { return h; }
+
+	double roadLeftBottomX()  const { return leftBottom; }
+	double roadRightBottomX() const { return rightBottom; }
+	double roadLeftTop()      const { return leftTop; }
+	double roadRightTop()     const { return rightTop; }
+
+	double edgeLeftX(double y)  const { return leftAt0 + leftSlope * y; }
+	double edgeRightX(double y) const { return rightAt0 + rightSlope * y; }
+
+	// 奥(0)〜手前(1)
+	double depth(double y) const { return Saturate((y - roadYTop) * kInvSpan); }
+
+	// 道路上の y（= 画面 y）・レーン位置にある物体の矩形。幅は道幅に、高さは奥行きに比例
+	RectF project(double y, double laneT, double widthFrac, double heightAtBottom) const {
+		const double l = edgeLeftX(y);
+		const double r = edgeRightX(y);
+		const double wRoad = Max(0.0, r - l);
+
+		const double ow = wRoad * widthFrac;
+		const double cx = l + (r - l) * laneT;
+		const double oh = Max(12.0, heightAtBottom * Math::Lerp(0.35, 1.0, depth(y)));
+
+		return RectF{ cx - ow * 0.5, y - oh, ow, oh };
+	}
+
+private:
+	static constexpr double kInvSpan = 1.0 / (roadYBottom - roadYTop);
+
+	double w = 0.0, h = 0.0;
+	double leftBottom = 0.0, rightBottom = 0.0, leftTop = 0.0, rightTop = 0.0;
+	double leftSlope = 0.0, rightSlope = 0.0, leftAt0 = 0.0, rightAt0 = 0.0;
+};
+
+//============================= Stage4（横断歩道） =============================
+struct Stage4Sim : StageSim {
+	static constexpr int32 StageId = 4;
+
+	enum class Light { Red, Green };
+
+	bool wasOnCrosswalk = false;
+
+	//============== 道路 ==============
+	RoadProjection road;
+
+	RectF crossTrigger{ 270, 510, 550, 100 }; // {X, Y, Width, Height}
+
+	bool wasInCrossTrigger = false;
+
+	bool   controlLocked = false;
+	double respawnTimer = 0.0;
+
+	bool overlapsWorld(const RectF& r) const {
+		return colliders.overlaps(r);
+	}
+
+	Light prevLight = Light::Red;
+
+	bool isInCrossTrigger(const RectF& r) const {
+		return r.intersects(crossTrigger);
+	}
+
+
+	//============== 車 ==============
+	struct DepthCar {
+		double y = RoadProjection::roadYTop - 60.0;
+		double speed = 780.0;
+		bool   active = false;
+
+		double widthFrac = 0.38;
+		double baseHeightBottom = 120.0;
+
+		double laneT = 0.33;
+
+		void spawnFar() {
+			y = RoadProjection::roadYTop - 80.0;
+			active = true;
+		}
+		void update(double dt) {
+			if (!active) return;
+			y += speed * dt;
+			if (y > RoadProjection::roadYBottom + 220.0) active = false;
+		}
+
+		// 投影矩形
+		RectF projectedRect(const RoadProjection& road) const {
+			return road.project(y, laneT, widthFrac, baseHeightBottom);
+		}
+
+# if !SINLAND_HEADLESS
+		// アトラスには奥行きごとの大きさを何段か焼き、一番近い段を少しだけ伸縮して使う。
+		// 縁取りや角の丸みは px で描いているので、1枚を大きく伸縮すると遠くの車の見た目が変わる
+		static constexpr int32  kSpriteSizes = 10;
+		static constexpr double kSpriteMinW = 48.0;
+		static constexpr double kSpriteStep = 1.25;   // 隣の段との幅の比
+
+		static double SpriteWidth(const int32 i) { return kSpriteMinW * Math::Pow(kSpriteStep, i); }
+
+		static int32 SpriteIndexFor(const double width) {
+			const double i = Math::Log(Max(width, 1.0) / kSpriteMinW) / Math::Log(kSpriteStep);
+			return Clamp((int32)Math::Round(i), 0, kSpriteSizes - 1);
+		}
+
+		// i 段目の車体の大きさ（道路上で幅がちょうど SpriteWidth(i) になる位置での投影）
+		static Vec2 SpriteSize(const RoadProjection& road, const int32 i) {
+			constexpr double y0 = RoadProjection::roadYTop, y1 = RoadProjection::roadYBottom;
+			DepthCar car;
+			car.y = y0;
+			const double w0 = car.projectedRect(road).w;
+			car.y = y1;
+			const double w1 = car.projectedRect(road).w;
+			// 幅は y の一次式
+			car.y = y0 + (SpriteWidth(i) - w0) * (y1 - y0) / (w1 - w0);
+			return Vec2{ SpriteWidth(i), car.projectedRect(road).h };
+		}
+
+		void draw(const RoadProjection& road, DrawList& list) const {
+			if (!active) return;
+			const RectF r = projectedRect(road);
+			const int32 i = SpriteIndexFor(r.w);
+			const Vec2 baked = SpriteSize(road, i);
+			if (SpriteAtlas::Add(list, Sprite::Car, i, r.pos, Vec2{ r.w / baked.x, r.h / baked.y })) return;
+			Paint(list, r);
+		}
+
+		// r は車体の投影矩形（影とタイヤは下にはみ出す）
+		static void Paint(DrawList& list, const RectF& r) {
+			const double w = r.w, h = r.h;
+
+			// 影
+			list.add(Ellipse{ r.center().movedBy(0, h * 0.55), w * 0.42, h * 0.22 }, ColorF(0, 0, 0, 0.08));
+
+			// ==== ボディ（正面）====
+			// ロアボディ
+			RoundRect lower = RectF(r.x + 4, r.y + h * 0.65, w - 8, h * 0.30).rounded(10);
+			list.add(lower, ColorF(0.07));
+
+			// キャビン
+			RoundRect cab = RectF(r.x + w * 0.06, r.y + h * 0.05, w * 0.88, h * 0.62).rounded(12);
+			list.add(cab, ColorF(0.18));
+			list.add(RectF(cab.rect.x + 6, cab.rect.y + 6, cab.rect.w - 12, cab.rect.h - 12).rounded(10), ColorF(0.93));
+
+			// フロントガラス
+			RoundRect windshield = RectF(r.x + w * 0.20, r.y + h * 0.10, w * 0.60, h * 0.28).rounded(10);
+			list.add(windshield, ColorF(0.09, 0.12, 0.16, 0.85));
+			// 反射ハイライト
+			list.add(Quad(
+				windshield.rect.tl().movedBy(6, 6),
+				windshield.rect.tr().movedBy(-18, 4),
+				windshield.rect.tr().movedBy(-8, windshield.rect.h * 0.40),
+				windshield.rect.tl().movedBy(10, windshield.rect.h * 0.45)
+			), ColorF(1, 1, 1, 0.06));
+
+			// ボンネットのハイライト
+			RoundRect hood = RectF(r.x + w * 0.10, r.y + h * 0.48, w * 0.80, h * 0.12).rounded(8);
+			list.add(hood, ColorF(1, 1, 1, 0.08));
+
+			// グリル
+			RoundRect grill = RectF(r.x + w * 0.22, r.y + h * 0.66, w * 0.56, h * 0.08).rounded(6);
+			list.add(grill, ColorF(0.06));
+
+			// ヘッドライト
+			const double lampW = w * 0.12;
+			const double lampH = h * 0.10;
+			RoundRect lampL = RectF(r.x + w * 0.06, r.y + h * 0.63, lampW, lampH).rounded(6);
+			RoundRect lampR = RectF(r.x + w * 0.82, r.y + h * 0.63, lampW, lampH).rounded(6);
+			list.add(lampL, ColorF(1.0, 0.95, 0.75, 0.95));
+			list.add(lampR, ColorF(1.0, 0.95, 0.75, 0.95));
+
+			// フォグ
+			RoundRect fogL = RectF(r.x + w * 0.18, r.y + h * 0.74, w * 0.16, h * 0.06).rounded(4);
+			RoundRect fogR = RectF(r.x + w * 0.66, r.y + h * 0.74, w * 0.16, h * 0.06).rounded(4);
+			list.add(fogL, ColorF(0.9, 0.95, 1.0, 0.18));
+			list.add(fogR, ColorF(0.9, 0.95, 1.0, 0.18));
+
+			// バンパー下のスリット
+			list.add(RectF(r.x + w * 0.28, r.y + h * 0.73, w * 0.44, h * 0.035).rounded(3), ColorF(0.1));
+
+			// タイヤ
+			const double wheelR = h * 0.16;
+			list.add(Circle(r.x + w * 0.18, r.y + h * 0.98, wheelR), ColorF(0.05));
+			list.add(Circle(r.x + w * 0.82, r.y + h * 0.98, wheelR), ColorF(0.05));
+		}
+# endif
+	};
+
+	//============== 配置 ==============
+	const Vec2  startPos{ 120, 540 };
+	const RectF crosswalk{ 360, 560, 240, 24 }; // 横断歩道
+	const RectF sensor{ 176, 520, 1, 44 };      // センサー
+	RectF goalDoor{ 0, 450, 60, 80 };
+
+	//============== 信号 / タイミング ==============
+	Light  light = Light::Red;
+	double senseHold = 0.0;
+	static constexpr double kHoldToGreen = 2.0; // 青に必要な滞在秒
+	static constexpr double kGreenWindow = 3.5; // 青の持続秒
+	double greenRemain = 0.0;
+	bool   goalAppeared = false;
+
+	//============== 車制御（奥→手前） ==============
+	Array<DepthCar> cars;   // 既定は2台（左右のレーン）
+	bool   carQueued = false;
+	double carSpawnDelay = 0.18;
+	double carSpawnT = 0.0;
+
+	// 轢かれ演出（プレイヤーの位置そのものなので、演出用のパーティクルではなく sim の double で動かす）
+	bool  knocked = false;
+	Vec2  knockVel{ 0, 0 };
+	static constexpr double gravityY = 1600.0;
+	static constexpr double groundY = 560.0;
+
+	SimRng rng;
+
+	explicit Stage4Sim(uint64 seed = 0, const SimLoad& load = {}) : rng{ seed } {
+		platforms = {
+			RectF{ 0, crosswalk.y - 15, (double)sceneSize.x, (double)sceneSize.y - (crosswalk.y - 15) }
+		};
+		colliders = MakeLevelColliders(sceneSize, platforms);
+
+		player.snapTo(Vec2{ 120, 500 });
+
+		goalDoor = RectF{ (double)sceneSize.x - 70.0, 470, 60, 80 };
+
+		road.resize(sceneSize);
+
+		// レーン（2台なら 0.33 / 0.67）
+		cars.resize(Max(load.cars, 1));
+		for (size_t i = 0; i < cars.size(); ++i) {
+			cars[i].laneT = (cars.size() == 1) ? 0.5 : (0.33 + 0.34 * i / (cars.size() - 1));
+		}
+	}
+
+	bool anyCarActive() const {
+		return std::any_of(cars.begin(), cars.end(), [](const DepthCar& c) { return c.active; });
+	}
+
+protected:
+	//============== ヘルパ ==============
+	RectF playerRect() const { return RectF{ player.pos, player.size }; }
+	void warpPlayerToStart() {
+		const double safeY = groundY - player.size.y - 2.0;
+		Vec2 p{ startPos.x, Min(startPos.y, safeY) };
+
+		for (int i = 0; i < 10 && overlapsWorld(RectF{ p, player.size }); ++i) {
+			p.y -= 2.0;
+		}
+		player.snapTo(p);
+		player.vel = Vec2{ 0, 0 };
+	}
+
+	void resetAfterHit() {
+		for (auto& car : cars) car.active = false;
+		carQueued = false;
+		carSpawnT = 0.0;
+		warpPlayerToStart();
+		controlLocked = true;
+		respawnTimer = 0.5;
+		knocked = false;
+		wasOnCrosswalk = false;
+		senseHold = 0.0;
+	}
+
+	void tick(const PlayerInput& in, double dt) override {
+		// リスポーン凍結
+		if (respawnTimer > 0.0) {
+			respawnTimer -= dt;
+			if (respawnTimer <= 0.0) { controlLocked = false; respawnTimer = 0.0; }
+		}
+		if (!controlLocked) { StageSim::tick(in, dt); }
+
+		const RectF prect{ player.pos, player.size };
+
+		const bool inCross = isInCrossTrigger(prect);
+		const bool enteredCrossThisFrame = (inCross && !wasInCrossTrigger);
+		wasInCrossTrigger = inCross;
+
+		const Light before = light;
+
+		// --- センサー：滞在で青化 ---
+		{
+			const double px = prect.center().x;
+			const double sx = sensor.center().x;
+			const double distX = Abs(px - sx);
+			constexpr double kSensorThreshold = 3.5;
+
+			if (distX < kSensorThreshold
+				&& prect.y < sensor.y + sensor.h
+				&& prect.y + prect.h > sensor.y) {
+				senseHold = Min(senseHold + dt, kHoldToGreen);
+				if (senseHold >= kHoldToGreen && light == Light::Red) {
+					light = Light::Green;
+					greenRemain = kGreenWindow;
+					emit(SimEvent::PlayGreen);
+				}
+			}
+			else {
+				senseHold = Max(0.0, senseHold - dt * 0.7);
+			}
+		}
+
+		// --- 青の残り ---
+		if (light == Light::Green) {
+			greenRemain -= dt;
+			if (greenRemain <= 0.0) { light = Light::Red; senseHold = 0.0; }
+		}
+
+		if (light == Light::Red && enteredCrossThisFrame) {
+			if (!anyCarActive()) {
+				for (auto& car : cars) car.spawnFar();
+				emit(SimEvent::PlayCarApproach);
+			}
+		}
+
+		const bool turnedToRedThisFrame = (before == Light::Green && light == Light::Red);
+		if (turnedToRedThisFrame && inCross) {
+			if (!anyCarActive()) {
+				for (auto& car : cars) car.spawnFar();
+				emit(SimEvent::PlayCarApproach);
+			}
+		}
+
+		// 車
+		for (auto& car : cars) car.update(dt);
+
+		// 衝突
+		if (!knocked) {
+			const bool hit = std::any_of(cars.begin(), cars.end(),
+				[&](const DepthCar& c) { return c.active && c.projectedRect(road).intersects(prect); });
+			if (hit) {
+				knocked = true; controlLocked = true; player.vel = Vec2{ 0,0 };
+				knockVel = Vec2(rng.uniform(-120.0, 120.0), -560.0);
+				emit(SimEvent::StopAllAudio);
+				emit(SimEvent::PlayCarHit);
+				emit(SimEvent::PlayCarHit2);
+			}
+		}
+
+		// ゴール判定
+		if (!controlLocked && prect.intersects(goalDoor)) {
+			emit(SimEvent::StopAllAudio);
+			emit(SimEvent::StopStage4BGM);
+			finish();
+			return;
+		}
+
+		// ノックバック物理
+		if (knocked) {
+			knockVel.y += gravityY * dt;
+			player.pos += knockVel * dt;
+			if (player.pos.y + player.size.y > groundY) {
+				player.pos.y = groundY - player.size.y; knockVel.y = 0.0;
+			}
+			if (!anyCarActive()) {
+				resetAfterHit();
+				return;
+			}
+		}
+	}
+};
+
+//============================= StageLast（部屋） =============================
+struct StageLastSim : StageSim {
+	static constexpr int32 StageId = 12;   // Stage 12（Last Stage）
+
+	// 家具当たり/描画用
+	RectF chairArea{ 860, 540, 60, 40 };   // イス座面
+	RectF deskArea{ 820, 520, 120, 20 };  // デスク天板
+	RectF pcRect{ 880, 470,  40, 28 };  // モニタ
+	RectF towerRect{ 830, 540,  20, 40 };  // PC本体
+	RectF decoStep{ 720, 560,  80, 20 };
+
+	bool  sitting = false;
+	bool  clicked = false;
+	bool  blackedOut = false;
+	double sitT = 0.0;        // 着席からの経過（sim 時間）
+	double blackoutT = 0.0;   // 暗転からの経過（sim 時間）
+
+	const double blackoutDelay = 2.1;   // 暗転開始（即時黒）
+	const double holdBlack = 0.20;  // 黒を見せる時間
+	const double clickLead = 0.25;  // シーン遷移までの時間
+
+	explicit StageLastSim(uint64 = 0, const SimLoad& = {}) {
+		platforms = { RectF{ 0, 580, 960, 60 } };
+		colliders = MakeLevelColliders(sceneSize, platforms);
+
+		player.snapTo(Vec2{ 40, 540 });
+	}
+
+protected:
+	void tick(const PlayerInput& in, double dt) override {
+		if (!sitting) {
+			const bool left = in.left;
+			const bool right = in.right;
+
+			double ax = 0.0;
+			if (left ^ right) {
+				const double a = player.grounded ? player.moveAccel * 0.8 : player.airAccel * 0.8;
+				ax = (left ? -a : a);
+			}
+			const double maxX = player.maxSpeedX * 0.7;
+
+			player.prevPos = player.pos;
+
+			player.vel.x += ax * dt;
+			player.vel.x -= player.vel.x * Min((player.grounded ? player.groundFric : player.airFric) * dt, 1.0);
+			player.vel.x = Clamp(player.vel.x, -maxX, maxX);
+			// 縦は重力（着地維持・ジャンプ禁止）
+			player.vel.y += player.gravity * dt;
+
+			player.moveAndCollide(colliders, dt);
+			player.jumpedThisFrame = false;
+			player.advanceAnim(dt);
+
+			const RectF playerAABB{ player.pos, player.size };
+			if (playerAABB.intersects(chairArea)) {
+				sitting = true;
+				emit(SimEvent::StopStageLastBGM);
+				player.vel = Vec2{ 0,0 };
+				player.snapTo(Vec2{ chairArea.x + 14, chairArea.y - player.size.y + 12 });
+
+				sitT = 0.0;
+			}
+		}
+		else {
+			sitT += dt;
+			const double t = sitT;
+
+			const double clickAt = Max(0.0, blackoutDelay - clickLead);
+			if (!clicked && t >= clickAt) {
+				clicked = true;
+				emit(SimEvent::PlayClick);
+			}
+			if (blackedOut) blackoutT += dt;
+			if (!blackedOut && t >= blackoutDelay) {
+				blackedOut = true;
+				blackoutT = 0.0;
+			}
+			if (blackedOut && blackoutT >= holdBlack) {
+				emit(SimEvent::StopAllAudio);
+				finish();
+			}
+		}
+	}
+};
+
+//============================= タイトルの背景 =============================
+// 1.5秒ごとに画面のどこかへ輪を出す（60fps で 1フレーム 3% ずつ薄く、0.8〜1.5% ずつ縮む）
+struct TitleRings {
+	static constexpr double kInterval = 1.5;
+
+	ParticlePool pool;
+	int32  perSpawn = 1;
+	double since = 0.0;
+	SimRng rng;
+
+	explicit TitleRings(uint64 seed = 0, const SimLoad& load = {})
+		: pool{ 8 * (size_t)Max(load.rings, 1), ParticlePool::Params{
+			.shape = ParticlePool::Shape::Ring, .fade = 1.8f, .minAlpha = 0.02f } }
+		, perSpawn{ Max(load.rings, 1) }
+		, rng{ seed } {}
+
+	void update(const double dt, const Size area) {
+		since += dt;
+		if (since >= kInterval) {
+			pool.emitBurst((size_t)perSpawn, [&](size_t) {
+				return ParticlePool::Spawn{
+					.pos = Vec2{ rng.uniform(0.0, (double)area.x), rng.uniform(0.0, (double)area.y) },
+					.size = rng.uniform(280.0, 420.0), .alpha = 0.35, .shrink = rng.uniform(0.48, 0.9) };
+			});
+			since = 0.0;
+		}
+		pool.update(dt);
+	}
+};
+
+//============================= ここから Siv3D（描画・音・入力・シーン） =============================
+# if !SINLAND_HEADLESS
+
+//============================= 共有データ =============================
+struct Shared {
+	int unlocked = 1;
+	int32 inputLatencyUs = -1;    // Stage2 のキャリブレーションで測った入力の遅れ（-1: 未測定）
+	Optional<InputTape> replay;   // 起動引数 --replay の記録（そのステージの開始時に受け取る）
+};
+
+//============================= 音アセット =============================
+// 使う音はすべてここに並べる。名前の文字列ではなく Sound の値で引くので、
+// 綴りを間違えるとコンパイルが通らない
+enum class Sound : uint8 {
+	UIEnter, UISelect,
+	Clear, Door,
+	Monkey, Button, Stage1BGM,
+	Heartbeat,
+	Push, Break,
+	CarHit, CarHit2, CarApproach, Green, Stage4BGM,
+	Click, StageLastBGM,
+	Count
+};
+
+struct SoundEntry {
+	Sound id;
+	const char32* name;     // AudioAsset の登録名（ログにも出す）
+	const char32* path;
+	double volume;
+	bool loop;
+	bool stopOnExit;        // StopAllAudio で止める（鳴り続ける音・長い音）
+};
+
+inline constexpr SoundEntry SoundManifest[] = {
+	{ Sound::UIEnter,      U"UIenterSE",    U"Assets/UIenterSE.mp3",      0.5,  false, false },
+	{ Sound::UISelect,     U"UIselectSE",   U"Assets/UIselectSE.mp3",     1.0,  false, false },
+	{ Sound::Clear,        U"clearSE",      U"Assets/clearSE.mp3",        0.9,  false, false },
+	{ Sound::Door,         U"doorSE",       U"Assets/doorSE.mp3",         1.0,  false, false },
+	{ Sound::Monkey,       U"monkeySE",     U"Assets/monkeySE.mp3",       0.4,  false, true  },
+	{ Sound::Button,       U"buttonSE",     U"Assets/buttonSE.mp3",       1.4,  false, false },
+	{ Sound::Stage1BGM,    U"stage1BGM",    U"Assets/stage1BGM.mp3",      0.15, true,  true  },
+	{ Sound::Heartbeat,    U"heartbeat",    U"Assets/heartbeats.mp3",     0.8,  false, true  },
+	{ Sound::Push,         U"PushSE",       U"Assets/pushPencilSE.mp3",   1.5,  false, false },
+	{ Sound::Break,        U"BreakSE",      U"Assets/pencilBreakSE.mp3",  1.5,  false, false },
+	{ Sound::CarHit,       U"carSE",        U"Assets/carSE.mp3",          0.8,  false, false },
+	{ Sound::CarHit2,      U"car2SE",       U"Assets/car2SE.mp3",         0.8,  false, false },
+	{ Sound::CarApproach,  U"car3SE",       U"Assets/car3SE.mp3",         0.8,  false, true  },
+	{ Sound::Green,        U"green2SE",     U"Assets/green2SE.mp3",       0.3,  false, true  },
+	{ Sound::Stage4BGM,    U"stage4BGM",    U"Assets/stage4BGM.mp3",      0.25, true,  true  },
+	{ Sound::Click,        U"clickSE",      U"Assets/clickSE.mp3",        1.0,  false, false },
+	{ Sound::StageLastBGM, U"stageLastBGM", U"Assets/stageLastBGM.mp3",   0.2,  true,  true  },
+};
+
+// 表の並びと enum の並びが一致していること（添字で直接引くため）
+constexpr bool SoundManifestInOrder() {
+	for (size_t i = 0; i < std::size(SoundManifest); ++i)
+		if ((size_t)SoundManifest[i].id != i) return false;
+	return true;
+}
+static_assert(std::size(SoundManifest) == (size_t)Sound::Count);
+static_assert(SoundManifestInOrder());
+
+// 起動時に一度だけ裏で読み込み、読み終わったものから配列にハンドルを取り出す。
+// 以後は配列の添字で Audio を返す（読み終わる前の Get は空の Audio：鳴らない）
+class Sounds {
+public:
+	// これ以下の大きさの効果音は自前で Wave に展開し、先頭の無音を削ってから Audio にする
+	// （ボタンや鼓動は押した・拍が来た瞬間に鳴ってほしいので）。それより大きいものは AudioAsset で読む
+	static constexpr int64 PcmMaxFileBytes = 64 * 1024;
+
+	static void LoadAsync() {
+		for (const auto& e : SoundManifest) {
+			const size_t i = (size_t)e.id;
+			traceNames[i] = "load " + Unicode::Narrow(e.name);
+			traceIds[i] = FrameProfiler::Register(traceNames[i].c_str());
+			issuedNs[i] = FrameProfiler::NowNs();
+
+			// ループする BGM は全体を展開せず、再生しながらファイルから少しずつ読む（つなぎ目もサンプル単位でループ）
+			if (e.loop) {
+				resolve(e, Audio{ Audio::Stream, e.path, Loop::Yes });
+				continue;
+			}
+			if (FileSystem::FileSize(e.path) <= PcmMaxFileBytes) {
+				pcm[(size_t)e.id] = Async(DecodePcm, String{ e.path });
+				continue;
+			}
+			AudioAsset::Register(e.name, e.path);
+			AudioAsset::LoadAsync(e.name);
+		}
+	}
+
+	// 毎フレーム呼ぶ
+	static void Update() {
+		if (readyCount == Total()) return;
+		for (const auto& e : SoundManifest) {
+			const size_t i = (size_t)e.id;
+			if (resolved[i]) continue;
+			if (pcm[i].isValid()) {
+				if (pcm[i].isReady()) resolvePcm(e);
+			}
+			else if (AudioAsset::IsReady(e.name)) {
+				resolve(e, AudioAsset(e.name));
+			}
+		}
+	}
+
+	// 読み終わっていないものを待つ
+	static void Wait() {
+		for (const auto& e : SoundManifest) {
+			const size_t i = (size_t)e.id;
+			if (resolved[i]) continue;
+			if (pcm[i].isValid()) {
+				resolvePcm(e);   // get() が終わるまで待つ
+			}
+			else {
+				AudioAsset::Wait(e.name);
+				resolve(e, AudioAsset(e.name));
+			}
+		}
+	}
+
+	static const Audio& Get(const Sound id) { return handles[(size_t)id]; }
+
+	// Wave に展開した効果音の中身（展開していない音は空）
+	static const Wave& GetPcm(const Sound id) { return waves[(size_t)id]; }
+
+	static size_t ReadyCount() { return readyCount; }
+	static constexpr size_t Total() { return (size_t)Sound::Count; }
+	static size_t PcmBytes() { return pcmBytes; }
+
+	// 最初に -60dB 以上の音が出るサンプル（全部無音なら size()）
+	static size_t FirstAudible(const Wave& w) {
+		constexpr float kSilence = 1.0f / 1024;
+		size_t i = 0;
+		while (i < w.size() && Abs(w[i].left) < kSilence && Abs(w[i].right) < kSilence) ++i;
+		return i;
+	}
+
+	// 起動引数 --measure-se。押した・拍が来た瞬間に鳴ってほしい効果音について、play() から
+	// 「再生位置が動き出すまで」と「最初に音が出るサンプルを再生位置が越えるまで」の時間を、
+	// 以前の読み方（mp3 をそのまま Audio にする＝AudioAsset と同じ）と今の読み方（先頭を削った PCM）で測ってログに出す。
+	// 再生位置はミキサーのバッファ単位でしか進まないので、分解能はバッファ1つぶん。音量 0 で鳴らす
+	static void MeasureLatency() {
+		constexpr Sound kTargets[] = { Sound::Button, Sound::Push, Sound::UISelect, Sound::Heartbeat, Sound::Click };
+		constexpr int32 kTrials = 8;
+
+		for (const Sound id : kTargets) {
+			const SoundEntry& e = SoundManifest[(size_t)id];
+			const Wave file{ e.path };
+			const Audio before{ e.path };
+			const Audio after = GetPcm(id).isEmpty() ? Audio{} : Audio{ GetPcm(id) };
+
+			const auto measure = [&](const Audio& a, const size_t onset, const char32* label) {
+				if (!a) { Logger << U"se latency: {} {} (not loaded)"_fmt(e.name, label); return; }
+				Array<double> moved, audible;
+				for (int32 t = 0; t < kTrials; ++t) {
+					const auto [m, h] = MeasureStart(a, onset);
+					moved << m;
+					audible << h;
+				}
+				std::sort(moved.begin(), moved.end());
+				std::sort(audible.begin(), audible.end());
+				Logger << U"se latency: {} {}  first move {:.1f} ms / first sound {:.1f} ms (median of {}, onset at {:.1f} ms)"_fmt(
+					e.name, label, moved[kTrials / 2] / 1000.0, audible[kTrials / 2] / 1000.0, kTrials,
+					onset * 1000.0 / Max<uint32>(a.sampleRate(), 1));
+			};
+			measure(before, FirstAudible(file), U"mp3 ");
+			measure(after, GetPcm(id).isEmpty() ? 0 : FirstAudible(GetPcm(id)), U"pcm ");
+		}
+	}
+
+private:
+	struct Pcm {
+		Wave wave;
+		size_t onset = 0;         // 元のファイルで最初に音が出るサンプル
+		size_t trimmed = 0;       // 先頭から削ったサンプル数
+		int64 beginNs = 0, endNs = 0;   // ワーカーで展開していた時間
+	};
+
+	static inline std::array<Audio, (size_t)Sound::Count> handles;
+	static inline std::array<bool, (size_t)Sound::Count> resolved{};
+	static inline std::array<AsyncTask<Pcm>, (size_t)Sound::Count> pcm;
+	static inline std::array<Wave, (size_t)Sound::Count> waves;
+	static inline size_t readyCount = 0;
+	static inline size_t pcmBytes = 0;
+
+	// トレースに出す読み込みの区間
+	static inline std::array<std::string, (size_t)Sound::Count> traceNames;
+	static inline std::array<uint16, (size_t)Sound::Count> traceIds{};
+	static inline std::array<int64, (size_t)Sound::Count> issuedNs{};
+
+	// ワーカーで展開する。-60dB 未満を無音とみなし、立ち上がりを欠かないよう 64 サンプルだけ残して削る
+	static Pcm DecodePcm(const String path) {
+		constexpr size_t kKeep = 64;
+
+		const int64 beginNs = FrameProfiler::NowNs();
+		Pcm p{ Wave{ path } };
+		p.beginNs = beginNs;
+		p.onset = FirstAudible(p.wave);
+		if (p.onset < p.wave.size()) {   // 全部無音（読めなかった）ならそのまま
+			p.trimmed = (p.onset > kKeep) ? (p.onset - kKeep) : 0;
+			p.wave.erase(p.wave.begin(), p.wave.begin() + p.trimmed);
+		}
+		p.endNs = FrameProfiler::NowNs();
+		return p;
+	}
+
+	static void resolvePcm(const SoundEntry& e) {
+		const Pcm p = pcm[(size_t)e.id].get();
+		const double msPerSample = 1000.0 / Max<uint32>(p.wave.sampleRate(), 1);
+		const size_t bytes = p.wave.size() * sizeof(WaveSample);
+		pcmBytes += bytes;
+		// ファイル先頭の無音の長さ：削る前 → 削った後（再生の遅れを測ったものではない）
+		Logger << U"se: {} pcm {} KB  leading silence {:.1f} ms -> {:.1f} ms"_fmt(
+			e.name, bytes / 1024, p.onset * msPerSample, (p.onset - p.trimmed) * msPerSample);
+		waves[(size_t)e.id] = p.wave;
+		resolve(e, Audio{ p.wave }, p.beginNs, p.endNs);
+	}
+
+	// play() してから再生位置が動き出すまで・onset を越えるまでの µs（0.5 秒で諦める）
+	static std::pair<double, double> MeasureStart(const Audio& a, const size_t onset) {
+		constexpr uint64 kTimeoutUs = 500'000;
+		a.setVolume(0.0);
+		a.stop();
+		const uint64 t0 = Time::GetMicrosec();
+		a.play();
+		double moved = (double)kTimeoutUs, audible = (double)kTimeoutUs;
+		for (uint64 now = t0; now - t0 < kTimeoutUs; now = Time::GetMicrosec()) {
+			const int64 pos = a.posSample();
+			if (pos > 0 && moved == (double)kTimeoutUs) moved = (double)(now - t0);
+			if (pos > (int64)onset) { audible = (double)(now - t0); break; }
+			std::this_thread::yield();
+		}
+		a.stop();
+		return { moved, audible };
+	}
+
+	// AudioAsset の読み込みは頼んだ時刻から気づいた時刻までを区間にする
+	static void resolve(const SoundEntry& e, Audio a) {
+		resolve(e, std::move(a), issuedNs[(size_t)e.id], FrameProfiler::NowNs());
+	}
+
+	static void resolve(const SoundEntry& e, Audio a, const int64 beginNs, const int64 endNs) {
+		FrameProfiler::Span(traceIds[(size_t)e.id], 1, beginNs, endNs - beginNs);
+		a.setVolume(e.volume);
+		a.setLoop(e.loop);
+		handles[(size_t)e.id] = a;
+		resolved[(size_t)e.id] = true;
+		++readyCount;
+	}
+};
+
+void StopAllAudio()
+{
+	for (const auto& e : SoundManifest)
+		if (e.stopOnExit) Sounds::Get(e.id).stop();
+}
+//============================= 入力 =============================
+// ジャンプキーを押した時刻（Time::GetMicrosec）。Windows では 1ms ごとにキーを見るスレッドが
+// 押した瞬間を記録するので、フレームの境目に丸められない。それ以外では時刻は取れない（none）ので、
+// 押下はそのフレームの最初の tick に置かれる（フレーム単位の精度）
+class JumpPresses {
+public:
+	static void Start() {
+#	if SIV3D_PLATFORM(WINDOWS)
+		if (poller.joinable()) return;
+		poller = std::jthread{ [](std::stop_token stop) {
+			// 既定のタイマー分解能（約 15.6ms）のままだと sleep_for(1ms) が 1 周期ぶん寝てしまう
+			::timeBeginPeriod(1);
+			bool wasDown = false;
+			while (!stop.stop_requested()) {
+				const bool down = (::GetAsyncKeyState(VK_SPACE) | ::GetAsyncKeyState('W') | ::GetAsyncKeyState(VK_UP)) & 0x8000;
+				if (down && !wasDown) push(Time::GetMicrosec());
+				wasDown = down;
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+			}
+			::timeEndPeriod(1);
+		} };
+#	endif
+	}
+
+	// 毎フレーム最初に呼ぶ。前のフレームから今までに押された最初の時刻を取り出し、残りは捨てる
+	static void BeginFrame() {
+		const uint64 now = Time::GetMicrosec();
+		first.reset();
+		const uint32 h = head.load(std::memory_order_acquire);
+		for (uint32 t = tail.load(std::memory_order_relaxed); t != h; ++t) {
+			const uint64 v = ring[t % kRing];
+			if (frameUs <= v && v <= now && (!first || v < *first)) first = v;
+		}
+		tail.store(h, std::memory_order_release);
+		frameUs = now;
+	}
+
+	static Optional<uint64> FirstThisFrame() { return first; }
+	static uint64 FrameUs() { return frameUs; }   // このフレームで BeginFrame を呼んだ時刻
+
+private:
+	static constexpr uint32 kRing = 64;
+	// 書くのはポーリングのスレッド、読むのはメインスレッドだけ
+	static inline uint64 ring[kRing]{};
+	static inline std::atomic<uint32> head{ 0 }, tail{ 0 };
+	static inline std::jthread poller;
+	static inline Optional<uint64> first;
+	static inline uint64 frameUs = 0;
+
+	static void push(const uint64 us) {
+		const uint32 h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= kRing) return;   // 溢れたら捨てる
+		ring[h % kRing] = us;
+		head.store(h + 1, std::memory_order_release);
+	}
+};
+
+// キーはフレームごとに1回だけ読む
+static PlayerInput SamplePlayerInput() {
+	PlayerInput in;
+	in.left = (KeyA.pressed() || KeyLeft.pressed());
+	in.right = (KeyD.pressed() || KeyRight.pressed());
+	in.jump = (KeySpace.down() || KeyW.down() || KeyUp.down());
+	in.run = KeyShift.pressed();
+	return in;
+}
+
+//============================= 音 =============================
+// シミュレーションが出したイベントを実際の再生・停止に変換する
+static void PlaySimEvent(const SimEvent e) {
+	switch (e) {
+	case SimEvent::PlayMonkey:       Sounds::Get(Sound::Monkey).play(); break;
+	case SimEvent::PlayButton:       Sounds::Get(Sound::Button).play(); break;
+	case SimEvent::PlayDoor:         Sounds::Get(Sound::Door).play(); break;
+	case SimEvent::PlayClear:        Sounds::Get(Sound::Clear).play(); break;
+	case SimEvent::StopStage1BGM:    Sounds::Get(Sound::Stage1BGM).stop(); break;
+	case SimEvent::StartHeartbeat:   break;   // Stage2 が拍のループとして鳴らす
+	case SimEvent::StopHeartbeat:    break;
+	case SimEvent::PlayPush:         Sounds::Get(Sound::Push).play(); break;
+	case SimEvent::PlayBreak:        Sounds::Get(Sound::Break).play(); break;
+	case SimEvent::PlayGreen:        Sounds::Get(Sound::Green).play(); break;
+	case SimEvent::PlayCarApproach:  Sounds::Get(Sound::CarApproach).play(); break;
+	case SimEvent::PlayCarHit:       Sounds::Get(Sound::CarHit).play(); break;
+	case SimEvent::PlayCarHit2:      Sounds::Get(Sound::CarHit2).play(); break;
+	case SimEvent::StopStage4BGM:    Sounds::Get(Sound::Stage4BGM).stop(); break;
+	case SimEvent::PlayClick:        Sounds::Get(Sound::Click).play(); break;
+	case SimEvent::StopStageLastBGM: Sounds::Get(Sound::StageLastBGM).stop(); break;
+	case SimEvent::StopAllAudio:     StopAllAudio(); break;
+	case SimEvent::Cleared:          break;
+	}
+}
+
+//============================= フォント =============================
+// シーンをまたいで使い回すフォント。起動時に FontAsset へ登録して別スレッドで読み込み、
+// 画面に出る文字のグリフもそこで作っておく（シーンを切り替えた最初のフレームで作らない）
+class Fonts {
+public:
+	static void Preload() {
+		String ascii;
+		for (char32 c = U' '; c <= U'~'; ++c) ascii << c;
+
+		FontAsset::Register(U"title", 80, Typeface::Light);
+		FontAsset::Register(U"ui", 18);
+		FontAsset::Register(U"stat", 14);
+		FontAsset::Register(U"endroll", 36);
+
+		FontAsset::LoadAsync(U"title", U"シン・ランド");
+		FontAsset::LoadAsync(U"ui", ascii + String(UIGlyphs));
+		FontAsset::LoadAsync(U"stat", ascii);
+		FontAsset::LoadAsync(U"endroll", ascii + String(EndRollGlyphs));
+	}
+
+	static size_t ReadyCount() {
+		size_t n = 0;
+		for (const auto name : Names) n += FontAsset::IsReady(name);
+		return n;
+	}
+	static constexpr size_t Total() { return std::size(Names); }
+
+	static void Wait() {
+		for (const auto name : Names) FontAsset::Wait(name);
+	}
+
+	// 名前での表引きを毎回しないよう、最初に引いたハンドルを持ち回す
+	static const Font& Title()   { static const Font f = FontAsset(U"title");   return f; }
+	static const Font& UI()      { static const Font f = FontAsset(U"ui");      return f; }
+	static const Font& Stat()    { static const Font f = FontAsset(U"stat");    return f; }
+	static const Font& EndRoll() { static const Font f = FontAsset(U"endroll"); return f; }
+
+private:
+	static constexpr const char32* Names[] = { U"title", U"ui", U"stat", U"endroll" };
+
+	// ボタン・ステージ名・Stage4 のゲージに出る文字
+	static constexpr StringView UIGlyphs =
+		U"スタートステージセレクトデータ削除戻る"
+		U"森林心臓シャー芯信号真珠分身深海診察写真振動神寝室（準備中）"
+		U"センサー充電中青"
+		U"キャリブレーション：鼓動に合わせてジャンプキー入力の遅れを測る";
+
+	static constexpr StringView EndRollGlyphs =
+		U"　シン・ランド設計システムデザイン：サウンド効果音ラボスペシャルサンクスプレイヤーの皆様";
+};
+
+//============================= メモリ =============================
+// プロセスの最大常駐メモリ（バイト）。取れない環境では 0
+static size_t PeakRssBytes() {
+#	if SIV3D_PLATFORM(WINDOWS)
+	PROCESS_MEMORY_COUNTERS pmc{};
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.PeakWorkingSetSize;
+#	else
+	rusage ru{};
+	if (::getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#		if SIV3D_PLATFORM(MACOS)
+	return (size_t)ru.ru_maxrss;           // macOS はバイト
+#		else
+	return (size_t)ru.ru_maxrss * 1024;    // Linux は KB
+#		endif
+#	endif
+}
+
+//============================= 読み込み =============================
+// 音とフォントを起動直後から裏で読み込み、タイトルを出している間に終わらせる。
+// 起動から最初のフレーム・読み込み完了まで、各ステージの最初のフレームにかかった時間をログに出す
+class Preloader {
+public:
+	static void Begin(const Stopwatch& sinceStartup) {
+		startup = sinceStartup;
+		Fonts::Preload();
+		Sounds::LoadAsync();
+	}
+
+	// 毎フレーム、シーンの更新より前に呼ぶ
+	static void Update() {
+		if (readyMs >= 0.0) return;
+		Sounds::Update();
+		if (Progress() < 1.0) return;
+		readyMs = startup.msF();
+		SINLAND_PROF_MARK("assets ready", 0);
+		Logger << U"assets: {} sounds / {} fonts ready  {:.1f} ms after startup"_fmt(Sounds::Total(), Fonts::Total(), readyMs);
+	}
+
+	// ステージに入るとき：まだ読み終わっていなければここで待つ
+	static void Wait() {
+		if (readyMs >= 0.0) return;
+		Fonts::Wait();
+		Sounds::Wait();
+		Update();
+	}
+
+	static double Progress() {
+		return double(Sounds::ReadyCount() + Fonts::ReadyCount()) / (Sounds::Total() + Fonts::Total());
+	}
+	static bool Done() { return (readyMs >= 0.0); }
+	static double ReadyMs() { return readyMs; }
+
+	// ステージを作ったフレームで呼ぶ。そのフレームの長さを EndFrame で記録する
+	static void MarkStageEnter(const int stage) { enteringStage = stage; }
+
+	static void EndFrame(const double frameMs) {
+		if (firstFrameMs < 0.0) {
+			firstFrameMs = startup.msF();
+			Logger << U"startup: first frame {:.1f} ms"_fmt(firstFrameMs);
+		}
+		if (enteringStage >= 0) {
+			Logger << U"stage {}: first frame {:.2f} ms"_fmt(enteringStage, frameMs);
+			enteringStage = -1;
+		}
+	}
+
+private:
+	static inline Stopwatch startup;
+	static inline double firstFrameMs = -1.0;
+	static inline double readyMs = -1.0;
+	static inline int enteringStage = -1;
+};
+
+//============================= UI =============================
+struct UIButton {
+	RectF  rect;
+	String text;
+
+	double hoverDarken = 0.12;
+	double pressInset = 2.0;
+
+	mutable bool wasHovered = false;
+	bool enabled = true;
+
+	UIButton(const RectF& r, StringView t) : rect{ r }, text{ t } {}
+
+	// --- 入力なしの描画だけ ---
+	void draw(const Font& font) const {
+		const bool hovered = enabled && rect.mouseOver();
+		const bool pressing = hovered && MouseL.pressed();
+
+		const ColorF base = enabled ? ColorF{ 1.0 } : ColorF{ 0.92 };
+		const ColorF frame = enabled ? ColorF{ 0.2 } : ColorF{ 0.7 };
+		const ColorF textCol = enabled ? ColorF{ 0.1 } : ColorF{ 0.6 };
+
+		rect.draw(base);
+		if (enabled && hovered) { rect.draw(ColorF{ 0,0,0, hoverDarken }); }
+		if (enabled && pressing) { rect.stretched(-pressInset).draw(ColorF{ 0,0,0, 0.10 }); }
+		rect.drawFrame(2, 0, frame);
+		font(text).drawAt(rect.center(), textCol);
+	}
+
+	bool drawAndCheck(const Font& font) const {
+		const bool hovered = enabled && rect.mouseOver();
+		const bool pressing = hovered && MouseL.pressed();
+		const bool clicked = hovered && MouseL.down();
+
+		const ColorF base = enabled ? ColorF{ 1.0 } : ColorF{ 0.92 };
+		const ColorF frame = enabled ? ColorF{ 0.2 } : ColorF{ 0.7 };
+		const ColorF textCol = enabled ? ColorF{ 0.1 } : ColorF{ 0.6 };
+
+		rect.draw(base);
+		if (enabled && hovered) { rect.draw(ColorF{ 0,0,0, hoverDarken }); }
+		if (enabled && pressing) { rect.stretched(-pressInset).draw(ColorF{ 0,0,0, 0.10 }); }
+		rect.drawFrame(2, 0, frame);
+		font(text).drawAt(rect.center(), textCol);
+
+		// SE
+		if (hovered && !wasHovered)
+			Sounds::Get(Sound::UISelect).play();
+		if (clicked)
+			Sounds::Get(Sound::UIEnter).play();
+
+		wasHovered = hovered;
+		return (enabled && clicked);
+	}
+};
+
+//============================= シーン管理 =============================
+enum class State { Title, Select, Stage1, Stage2, Stage3, Stage4, StageLast, EndRoll };
+using App = SceneManager<State, Shared>;
+
+static void DrawGoal(const RectF& goal) {
+	goal.draw(ColorF{ 0.75, 0.94, 0.80 });
+	goal.drawFrame(2, 0, ColorF{ 0.15, 0.45, 0.2 });
+	Triangle{ goal.pos.movedBy(10, -20), goal.pos.movedBy(10, 0), goal.pos.movedBy(38, -10) }
+	.draw(ColorF{ 0.2, 0.7, 0.3 });
+	Line{ goal.pos.movedBy(10, -24), goal.pos.movedBy(10, 2) }.draw(3, ColorF{ 0.2, 0.2, 0.2 });
+}
+// 扉（共通 60×80）。Inset：白地＋内枠 / Glass：枠と色だけ / Solid：白地＋太枠
+enum class DoorStyle : uint8 { Inset, Glass, Solid };
+
+static void PaintDoor(DrawList& list, const RectF& door, DoorStyle style) {
+	if (style != DoorStyle::Glass) list.add(door, Palette::White);
+	if (style == DoorStyle::Inset) list.addFrame(door, 4, 0, ColorF{ 0.15,0.5,0.25 });
+	else list.addFrame(door, 2, 2, ColorF{ 0.15,0.5,0.25 });
+	list.add(RectF{ door.x + 6, door.y + 6, door.w - 12, door.h - 12 }, ColorF{ 0.85,1.0,0.9,0.35 });
+}
+
+static void DrawDoor(DrawList& list, const RectF& door, DoorStyle style) {
+	if (SpriteAtlas::Add(list, Sprite::Door, (int32)style, door.pos, Vec2{ door.w / 60.0, door.h / 80.0 })) return;
+	PaintDoor(list, door, style);
+}
+
+//----------------------------- Title -----------------------------
+class Title : public App::Scene {
+	UIButton start{ RectF{ Arg::center = Scene::Center().movedBy(0, 40), 220, 48 }, U"スタート" };
+	UIButton select{ RectF{ Arg::center = Scene::Center().movedBy(0, 100), 220, 48 }, U"ステージセレクト" };
+
+	TitleRings rings{ RandomUint64() };   // 背景の輪
+
+	bool   fading = false;
+	Stopwatch fadeSW{ StartImmediately::No };
+	double fadeOutSec = 0.6;
+
+	// === キーボード選択 ===
+	int focus = -1; // -1: 解除 / 0: start / 1: select
+
+	void drawFocusOverlay(const RectF& r) const {
+		r.draw(ColorF{ 0,0,0, 0.12 });
+		r.stretched(-2).draw(ColorF{ 0,0,0, 0.06 });
+		r.drawFrame(2, 0, ColorF{ 0,0,0, 0.15 });
+	}
+
+public:
+	Title(const InitData& init) : IScene{ init } {
+		SINLAND_PROF_MARK("scene Title", 0);
+	}
+
+	void update() override {
+		SINLAND_PROF_SCOPE("Title::update");
+		// 背景
+		rings.update(Scene::DeltaTime(), Scene::Size());
+		Scene::SetBackground(ColorF{ 0.96, 0.98, 1.0 });
+
+		// === マウスホバーがあればキーボード選択を解除 ===
+		const bool anyHover = (start.rect.mouseOver() || select.rect.mouseOver());
+		if (anyHover) focus = -1;
+
+		// === キー操作 ===
+		if (!fading) {
+			auto ensureFocus = [&]() { if (focus == -1) focus = 0; }; // 解除中に矢印で復帰したらStartへ
+
+			int prev = focus;
+			if (KeyLeft.down() || KeyUp.down()) { ensureFocus(); focus = Max(0, focus - 1); }
+			if (KeyRight.down() || KeyDown.down()) { ensureFocus(); focus = Min(1, focus + 1); }
+			if (focus != prev && focus != -1) Sounds::Get(Sound::UISelect).play();
+
+			if ((KeyEnter.down() || KeyK.down() || KeySpace.down()) && focus != -1) {
+				Sounds::Get(Sound::UIEnter).play();
+				if (focus == 0) { fading = true; fadeSW.restart(); }
+				else { StopAllAudio(); changeScene(State::Select, 0.3s); }
+			}
+		}
+
+		// 既存マウス
+		if (!fading) {
+			if (start.drawAndCheck(Fonts::UI())) { fading = true; fadeSW.restart(); }
+			if (select.drawAndCheck(Fonts::UI())) { StopAllAudio(); changeScene(State::Select, 0.3s); }
+		}
+		else {
+			if (fadeSW.sF() >= fadeOutSec) {
+				StopAllAudio();
+				changeScene(State::Stage1, 0.0s);
+			}
+		}
+
+		if (KeyEscape.down()) { System::Exit(); }
+	}
+
+	void draw() const override {
+		SINLAND_PROF_SCOPE("Title::draw");
+		rings.pool.draw(ColorF{ 0.5 });
+		Fonts::Title()(U"シン・ランド").drawAt(Scene::Center().movedBy(0, -60), ColorF{ 0.1 });
+
+		start.draw(Fonts::UI());
+		select.draw(Fonts::UI());
+
+		if (!fading && focus != -1) {
+			drawFocusOverlay((focus == 0) ? start.rect : select.rect);
+		}
+
+		if (fading) {
+			const double a = Clamp(fadeSW.sF() / fadeOutSec, 0.0, 1.0);
+			RectF(Scene::Rect()).draw(ColorF{ 0, 0, 0, a });
+		}
+
+		// 音・フォントの読み込み具合
+		if (!Preloader::Done()) {
+			RectF{ 0, Scene::Height() - 3, Scene::Width() * Preloader::Progress(), 3 }.draw(ColorF{ 0.1, 0.25 });
+		}
+	}
+};
+
+
+//----------------------------- Select -----------------------------
+class Select : public App::Scene {
+	struct StageEntry { String name; bool available; Optional<State> target; };
+	Array<StageEntry> entries;
+	Array<UIButton>   buttons;
+
+	UIButton deleteBtn{ RectF{ 20, 20, 120, 34 }, U"データ削除" };
+	UIButton backBtn{ RectF{ 0, 0, 120, 34 }, U"戻る" }; // ctorで中央上
+
+	// レイアウト
+	static constexpr int kCols = 3;
+	const double btnW = 220, btnH = 46, gapX = 64, gapY = 60;
+	double startX = 0, startY = 150;
+
+	// キーボード選択（-1: 解除 / 0: 戻る / 1: データ削除 / 2..: ステージ）
+	int focus = -1;
+
+	void drawFocusOverlay(const RectF& r) const {
+		r.draw(ColorF{ 0,0,0, 0.12 });
+		r.stretched(-2).draw(ColorF{ 0,0,0, 0.06 });
+		r.drawFrame(2, 0, ColorF{ 0,0,0, 0.15 });
+	}
+
+	void loadStageNamesIfAny() {
+		TextReader r{ U"Assets/StageNames.txt" };
+		if (!r) return;
+		Array<String> lines; String line;
+		while (r.readLine(line)) { lines << line.trimmed(); if (lines.size() >= entries.size()) break; }
+		for (size_t i = 0; i < Min(lines.size(), entries.size()); ++i) {
+			if (!lines[i].isEmpty()) entries[i].name = lines[i];
+		}
+	}
+
+	RectF rectOfIndex(int idx) const {
+		if (idx == 0) return backBtn.rect;
+		if (idx == 1) return deleteBtn.rect;
+		const int bi = idx - 2;
+		if (bi >= 0 && bi < (int)buttons.size()) return buttons[bi].rect;
+		return RectF{};
+	}
+	bool enabledOfIndex(int idx) const {
+		if (idx == 0) return true;
+		if (idx == 1) return true;
+		const int bi = idx - 2;
+		if (bi >= 0 && bi < (int)buttons.size()) return buttons[bi].enabled;
+		return false;
+	}
+
+public:
+	using App::Scene::Scene;
+
+	Select(const InitData& init) : App::Scene(init) {
+		SINLAND_PROF_MARK("scene Select", 0);
+		entries = {
+			{ U"1. 森林",       true,  State::Stage1   },
+			{ U"2. 心臓",       true,  State::Stage2   },
+			{ U"3. シャー芯",   true,  State::Stage3   },
+			{ U"4. 信号",       true,  State::Stage4   },
+			{ U"5. 真珠（準備中）", false, none            },
+			{ U"6. 分身（準備中）", false, none            },
+			{ U"7. 深海（準備中）", false, none            },
+			{ U"8. 診察（準備中）", false, none            },
+			{ U"9. 写真（準備中）", false, none            },
+			{ U"10. 振動（準備中）",false, none            },
+			{ U"11. 神（準備中）",false, none            },
+			{ U"12. 寝室",      true,  State::StageLast },
+		};
+		loadStageNamesIfAny();
+
+		// 戻るボタンを中央上に
+		{
+			const double w = backBtn.rect.w, h = backBtn.rect.h;
+			backBtn.rect = RectF{ Arg::center = Vec2{ Scene::CenterF().x, 37 }, w, h };
+		}
+
+		// ステージボタン（1行3）
+		const double totalW = kCols * btnW + (kCols - 1) * gapX;
+		startX = (Scene::Width() - totalW) * 0.5;
+
+		buttons.reserve(entries.size());
+		for (int i = 0; i < (int)entries.size(); ++i) {
+			const int r = i / kCols;
+			const int c = i % kCols;
+			const RectF rect{ startX + c * (btnW + gapX), startY + r * (btnH + gapY), btnW, btnH };
+			buttons << UIButton{ rect, entries[i].name };
+		}
+	}
+
+	void update() override {
+		SINLAND_PROF_SCOPE("Select::update");
+		Scene::SetBackground(ColorF{ 0.95, 0.98, 1.0 });
+
+		// enabled 更新
+		const int unlocked = getData().unlocked;
+		for (int i = 0; i < (int)buttons.size(); ++i) {
+			const bool impl = entries[i].available && entries[i].target.has_value();
+			const bool unlockedGate = ((i + 1) <= unlocked);
+			buttons[i].text = entries[i].name;
+			buttons[i].enabled = (impl && unlockedGate);
+		}
+
+		// === マウスにホバーがあればキーボード選択を解除 ===
+		bool anyHover = deleteBtn.rect.mouseOver() || backBtn.rect.mouseOver();
+		if (!anyHover) {
+			for (const auto& b : buttons) { if (b.rect.mouseOver()) { anyHover = true; break; } }
+		}
+		if (anyHover) focus = -1;
+
+		// === キー操作 ===
+		{
+			auto ensureFocus = [&]() { if (focus == -1) focus = 0; }; // 解除中に矢印が押されたら「戻る」から再開
+
+			const int prev = focus;
+			// 左右（データ削除 ↔ 戻る は左右どちらでも移動できる仕様のまま）
+			if (KeyLeft.down()) {
+				ensureFocus();
+				if (focus == 0) focus = 1;
+				else if (focus >= 2 && (focus - 2) % kCols != 0) focus -= 1;
+				else if (focus == 1) focus = 0;
+			}
+			if (KeyRight.down()) {
+				ensureFocus();
+				if (focus == 1) focus = 0;           // データ削除 -> 戻る
+				else if (focus == 0) focus = 1;      // 戻る -> データ削除
+				else if (focus >= 2 && (focus - 2) % kCols != kCols - 1 && (focus - 1) < (int)(buttons.size() + 1)) focus += 1;
+			}
+			// 上下
+			if (KeyUp.down()) {
+				ensureFocus();
+				if (focus >= 2) {
+					const int bi = focus - 2;
+					const int row = bi / kCols;
+					const int col = bi % kCols;
+					if (row == 0) focus = (col == 1 ? 0 : 1);
+					else focus -= kCols;
+				}
+			}
+			if (KeyDown.down()) {
+				ensureFocus();
+				if (focus <= 1) {
+					const int col = (focus == 0 ? 1 : 0); // back->中列, delete->左列
+					const int ni = 2 + col;
+					if (ni < 2 + (int)buttons.size()) focus = ni;
+				}
+				else if (focus + kCols < 2 + (int)buttons.size()) {
+					focus += kCols;
+				}
+			}
+			if (focus != prev && focus != -1) Sounds::Get(Sound::UISelect).play();
+
+			// 決定（解除中は無視）
+			if ((KeyEnter.down() || KeyK.down() || KeySpace.down()) && focus != -1) {
+				Sounds::Get(Sound::UIEnter).play();
+				if (focus == 0) { // 戻る
+					StopAllAudio();
+					changeScene(State::Title, 0.2s);
+					return;
+				}
+				if (focus == 1) { // データ削除
+					TextWriter writer{ U"Assets/SaveData.txt" };
+					if (writer) writer.writeln(U"1");
+					getData().unlocked = 1;
+					StopAllAudio();
+					changeScene(State::Title, 0.2s);
+					return;
+				}
+				const int bi = focus - 2;
+				if (bi >= 0 && bi < (int)entries.size()) {
+					if (entries[bi].available && entries[bi].target) {
+						StopAllAudio();
+						changeScene(*entries[bi].target, 0.2s);
+						return;
+					}
+				}
+			}
+		}
+
+		// === マウス操作（従来） ===
+		for (int i = 0; i < (int)buttons.size(); ++i) {
+			if (buttons[i].drawAndCheck(Fonts::UI())) {
+				if (entries[i].available && entries[i].target) {
+					StopAllAudio();
+					changeScene(*entries[i].target, 0.2s);
+				}
+				return;
+			}
+		}
+		if (deleteBtn.drawAndCheck(Fonts::UI())) {
+			TextWriter writer{ U"Assets/SaveData.txt" };
+			if (writer) writer.writeln(U"1");
+			getData().unlocked = 1;
+			StopAllAudio();
+			changeScene(State::Title, 0.2s);
+			return;
+		}
+		if (backBtn.drawAndCheck(Fonts::UI())) {
+			StopAllAudio();
+			changeScene(State::Title, 0.2s);
+			return;
+		}
+
+		if (KeyEscape.down()) {
+			StopAllAudio();
+			changeScene(State::Title, 0.2s);
+		}
+	}
+
+	void draw() const override {
+		SINLAND_PROF_SCOPE("Select::draw");
+		// 上部
+		deleteBtn.draw(Fonts::UI());
+		backBtn.draw(Fonts::UI());
+		// ステージ
+		for (const auto& b : buttons) b.draw(Fonts::UI());
+		// キーボードフォーカスは focus!=-1 かつ有効時のみ
+		if (focus != -1 && enabledOfIndex(focus)) {
+			drawFocusOverlay(rectOfIndex(focus));
+		}
+	}
+};
+//============================= 背景の焼き込み =============================
+// 変わらない背景を RenderTexture に一度だけ描き、以降のフレームは1枚貼るだけにする。
+// 画面サイズか key（背景の中身を左右する値）が変わったときだけ描き直す
+class LayerCache {
+public:
+	static inline bool Enabled = true;   // F2 で切り替え（焼き込みなしと描画コール数を比べる用）
+
+	template <class Paint>
+	void draw(uint64 key, Paint&& paint) const {
+		if (!Enabled) {
+			paint();
+			return;
+		}
+
+		// 画面と同じ 4x MSAA で焼く（円や斜めの線のアンチエイリアスを残す）
+		const Size size = Scene::Size();
+		if (!texture || (texture.size() != size)) {
+			texture = MSRenderTexture{ size };
+			valid = false;
+		}
+		if (!valid || (key != bakedKey)) {
+			texture.clear(ColorF{ 0.0, 0.0 });
+			{
+				const ScopedRenderTarget2D target{ texture };
+				paint();
+			}
+			Graphics2D::Flush();
+			texture.resolve();
+			bakedKey = key;
+			valid = true;
+		}
+		texture.draw();
+	}
+
+	void invalidate() { valid = false; }
+
+	// 焼き込みあり / なしそれぞれの1フレームの描画コール数。ステージに入ったら空にし、出るときにログへ出す
+	static void CountFrame(const bool enabled, const uint32 drawCalls) {
+		DrawCallSum[enabled] += drawCalls;
+		++DrawCallFrames[enabled];
+	}
+	static void ResetCounts() {
+		DrawCallSum[0] = DrawCallSum[1] = 0;
+		DrawCallFrames[0] = DrawCallFrames[1] = 0;
+	}
+	static void LogCounts(const int32 stage) {
+		const auto avg = [](const size_t i) { return (DrawCallFrames[i] ? (double)DrawCallSum[i] / DrawCallFrames[i] : 0.0); };
+		Logger << U"stage {}: draw calls  bake on {:.1f} ({} frames) / bake off {:.1f} ({} frames)"_fmt(
+			stage, avg(1), DrawCallFrames[1], avg(0), DrawCallFrames[0]);
+	}
+
+private:
+	static inline uint64 DrawCallSum[2]{};
+	static inline uint64 DrawCallFrames[2]{};
+
+	mutable MSRenderTexture texture;
+	mutable uint64 bakedKey = 0;
+	mutable bool   valid = false;
+};
+
+//============================= 粒の場 =============================
+// 星やほこりのように、置き場所は変わらず明るさだけが揺らぐ粒の集まり。
+// シードから一度だけ並べて要素ごとの配列（SoA）に持ち、瞬きは時刻の sin で付ける。
+// 状態を切り替えずに同じ図形を続けて描くので、Siv3D 側で1回の描画コールにまとまる
+class ParticleField {
+public:
+	struct Desc {
+		RectF  area;
+		size_t count = 0;
+		double minRadius = 1.0, maxRadius = 2.0;
+		double minAlpha = 0.3, maxAlpha = 0.6;
+		double minHz = 0.5, maxHz = 1.5;   // 瞬きの速さ
+		ColorF color{ 1.0 };
+	};
+
+	ParticleField(const Desc& desc, uint64 seed) : color{ desc.color } {
+		const size_t n = desc.count;
+		x.resize(n); y.resize(n); r.resize(n);
+		omega.resize(n); phase.resize(n); alphaMid.resize(n); alphaAmp.resize(n);
+
+		SimRng rng{ seed };
+		const double mid = (desc.minAlpha + desc.maxAlpha) * 0.5;
+		const double amp = (desc.maxAlpha - desc.minAlpha) * 0.5;
+		for (size_t i = 0; i < n; ++i) {
+			x[i] = (float)rng.uniform(desc.area.x, desc.area.x + desc.area.w);
+			y[i] = (float)rng.uniform(desc.area.y, desc.area.y + desc.area.h);
+			r[i] = (float)rng.uniform(desc.minRadius, desc.maxRadius);
+			omega[i] = (float)(Math::TwoPi * rng.uniform(desc.minHz, desc.maxHz));
+			phase[i] = (float)rng.uniform(0.0, Math::TwoPi);
+			alphaMid[i] = (float)mid;
+			alphaAmp[i] = (float)(amp * rng.uniform(0.5, 1.0));
+		}
+	}
+
+	void draw(double time) const {
+		for (size_t i = 0; i < x.size(); ++i) {
+			const double a = alphaMid[i] + alphaAmp[i] * Math::Sin(time * omega[i] + phase[i]);
+			Circle{ x[i], y[i], r[i] }.draw(color.withAlpha(a));
+		}
+	}
+
+	size_t size() const { return x.size(); }
+
+private:
+	ColorF color;
+	Array<float> x, y, r;
+	Array<float> omega, phase;         // 瞬きの角速度・位相
+	Array<float> alphaMid, alphaAmp;   // 明るさの中心・振れ幅
+};
+
+//============================= 形のキャッシュ =============================
+// Polygon の組み立て（頂点の生成と三角形分割）は一度だけ行って key ごとに持っておき、
+// 脈打つ・揺れるといった変化は Transformer2D で付ける
+class MeshCache {
+public:
+	// F3 の表示用（フレームごとに DrawRenderStats が読んで 0 に戻す）
+	static inline size_t FrameHits = 0;
+	static inline double FrameSavedUs = 0.0;   // 毎回組み立てていたら掛かっていた時間
+
+	struct Mesh {
+		Polygon polygon;
+		double  buildUs = 0.0;
+	};
+
+	template <class Build>
+	const Mesh& get(uint64 key, Build&& build) const {
+		if (const auto it = meshes.find(key); it != meshes.end()) {
+			++FrameHits;
+			FrameSavedUs += it->second.buildUs;
+			return it->second;
 		}
 
-		pencil.reset();               // 芯を消す（長さ0に戻す）
-		buttonPrevOverlap = false;    // ボタン再押下を確実に
-		wasOnLead = false;
+		const Stopwatch sw{ StartImmediately::Yes };
+		Mesh mesh{ build(), 0.0 };
+		mesh.buildUs = sw.usF();
+		return meshes.emplace(key, std::move(mesh)).first->second;
 	}
 
+	void clear() { meshes.clear(); }
+
+private:
+	mutable HashTable<uint64, Mesh> meshes;
+};
+
+//============================= 描画統計 =============================
+// F3 で前フレームの描画コール数・三角形数と、描画リスト・アトラス・各キャッシュの状況を表示
+static void DrawRenderStats() {
+	static bool visible = false;
+	const size_t prims = std::exchange(DrawList::FramePrims, 0);
+	const size_t runs = std::exchange(DrawList::FrameRuns, 0);
+	const size_t meshHits = std::exchange(MeshCache::FrameHits, 0);
+	const size_t bezierHits = std::exchange(BezierCache::FrameHits, 0);
+	const size_t bezierMisses = std::exchange(BezierCache::FrameMisses, 0);
+	const double meshSavedUs = std::exchange(MeshCache::FrameSavedUs, 0.0);
+	// 統計は前フレームのものなので、前フレームを描いたときの焼き込みの有無で数える
+	static bool drawnWithBake = LayerCache::Enabled;
+	LayerCache::CountFrame(drawnWithBake, Profiler::GetStat().drawCalls);
+	if (KeyF2.down()) LayerCache::Enabled = !LayerCache::Enabled;
+	drawnWithBake = LayerCache::Enabled;
+	if (KeyF3.down()) visible = !visible;
+	if (!visible) return;
+
+	const Font& fStat = Fonts::Stat();
+	const auto& stat = Profiler::GetStat();
+	fStat(U"draw calls {} / triangles {} / bake {}"_fmt(stat.drawCalls, stat.triangleCount, (LayerCache::Enabled ? U"on" : U"off")))
+		.draw(8, 8, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+	fStat(U"prims {} / runs {}"_fmt(prims, runs))
+		.draw(8, 26, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+	fStat(U"atlas {} KB / bake {:.1f} ms"_fmt(SpriteAtlas::MemoryBytes() / 1024, SpriteAtlas::TotalMs()))
+		.draw(8, 44, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+	fStat(U"mesh hits {} / saved {:.1f} us"_fmt(meshHits, meshSavedUs))
+		.draw(8, 62, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+	fStat(U"bezier hits {} / misses {} / cached {}"_fmt(bezierHits, bezierMisses, BezierCache::Size()))
+		.draw(8, 80, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+	fStat(U"assets {:.0f}% / ready {:.0f} ms / se pcm {} KB"_fmt(Preloader::Progress() * 100.0, Preloader::ReadyMs(), Sounds::PcmBytes() / 1024))
+		.draw(8, 98, ColorF{ 0.1, 0.1, 0.1, 0.9 });
+}
 
+//============================= トレースの書き出し =============================
+// --trace <file.json> で起動すると、計測区間・読み込み・シーン切り替えの印を Chrome のトレース形式
+// （chrome://tracing や Perfetto で開ける JSON）で書き出す。
+// メインスレッドはリングに積むだけで、整形と書き込みは別スレッドが行う
+class TraceRecorder {
 public:
-	Stage3(const InitData& init) : StageBase(init) {
-		const double groundY = 560.0;
+	static bool Start(const String& path) {
+		fp = std::fopen(path.narrow().c_str(), "w");
+		if (!fp) return false;
+		std::fputs("{\"traceEvents\":[\n", fp);
+		std::fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}", fp);
+		std::fputs(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"loader\"}}", fp);
+		writer = std::jthread{ [](std::stop_token stop) {
+			while (!stop.stop_requested()) {
+				drain();
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+			}
+			drain();
+		} };
+		return true;
+	}
 
-		// スタート島（シャーペン本体は固定長）
-		pencil.origin = Vec2{ 60, groundY };
-		pencil.bodyLen = 160;
-		pencil.leadStep = 80;
-		pencil.maxLead = 560;
+	static bool Enabled() { return (fp != nullptr); }
 
-		// ドア島（幅=80）
-		doorPad = RectF{ 770, groundY, 80, 14 };
-		door = RectF{ doorPad.centerX() - 30, doorPad.y - 80, 60, 80 };
+	// メインスレッドから呼ぶ。書き込みが追いつかず溢れた分は数だけ残す
+	static void Enqueue(const FrameProfiler::Sample& s) {
+		const uint32 h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= kRing) { ++dropped; return; }
+		ring[h % kRing] = s;
+		head.store(h + 1, std::memory_order_release);
+	}
 
-		// 固定床（ドア島のみ）※ペンは動的コライダで追加
-		platforms = { doorPad };
-		colliders = MakeLevelColliders(sceneSize, platforms);
+	// 残りを書いて閉じる
+	static void Stop() {
+		if (!fp) return;
+		writer.request_stop();
+		writer.join();
+		std::fprintf(fp, "\n],\"otherData\":{\"dropped\":%zu}}\n", dropped);
+		std::fclose(fp);
+		fp = nullptr;
+	}
 
-		// プレイヤー初期位置（少し右にシフト）
-		player = Player{};
-		startPos = Vec2{ pencil.origin.x + 24, pencil.origin.y - player.size.y }; // ← +24 に
-		player.pos = startPos;
+private:
+	static constexpr uint32 kRing = 32768;
+	static inline FrameProfiler::Sample ring[kRing]{};
+	static inline std::atomic<uint32> head{ 0 }, tail{ 0 };
+	static inline std::FILE* fp = nullptr;
+	static inline std::jthread writer;
+	static inline size_t dropped = 0;
+
+	// 書き込みスレッド。名前は Register 済みの英数字なのでエスケープしない
+	static void drain() {
+		const uint32 h = head.load(std::memory_order_acquire);
+		uint32 t = tail.load(std::memory_order_relaxed);
+		for (; t != h; ++t) {
+			const FrameProfiler::Sample& s = ring[t % kRing];
+			const char* name = FrameProfiler::Name(s.id);
+			if (s.durNs < 0) {
+				std::fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u,\"arg\":%d}}",
+					name, s.beginNs * 1e-3, (unsigned)s.lane, (unsigned)s.frame, (int)s.arg);
+			}
+			else {
+				std::fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u}}",
+					name, s.beginNs * 1e-3, s.durNs * 1e-3, (unsigned)s.lane, (unsigned)s.frame);
+			}
+		}
+		tail.store(t, std::memory_order_release);
+	}
+};
 
-		// ボタン：ノック（push）部分の上に配置
-		{
-			const RectF cap = pencil.capRect();
-			button = RectF{ cap.centerX() - 12, cap.y - 8, 24, 6 };
+//============================= 区間計測の表示 =============================
+// FrameProfiler のリングを毎フレーム空にして集計する。F4 で、区間ごとの平均 ms（直近 kWindow フレーム）、
+// フレーム間隔のパーセンタイル、1フレームの処理時間のグラフを出す
+class ProfilerOverlay {
+public:
+	// フレームの最後（計測区間の外）で呼ぶ
+	static void EndFrame() {
+		FrameProfiler::Sample smp;
+		double cpuMs = 0.0;
+		while (FrameProfiler::Pop(smp)) {
+			if (TraceRecorder::Enabled()) TraceRecorder::Enqueue(smp);
+			if (smp.lane != 0 || smp.durNs < 0) continue;   // 読み込み・印は表に出さない
+			const double ms = smp.durNs * 1e-6;
+			sumMs[smp.id] += ms;
+			depths[smp.id] = smp.depth;
+			if (smp.depth == 0) cpuMs += ms;
 		}
+		FrameProfiler::NextFrame();
 
-		// SE
-		AudioAsset::Register(U"BreakSE", U"Assets/pencilBreakSE.mp3");
-		AudioAsset(U"Break").setVolume(1.5);
-		AudioAsset::Register(U"PushSE", U"Assets/pushPencilSE.mp3");
-		AudioAsset(U"PushSE").setVolume(1.5);
-		AudioAsset::Register(U"clearSE", U"Assets/clearSE.mp3");
-		AudioAsset(U"clearSE").setVolume(0.9);
+		cpuHistory[cursor] = (float)cpuMs;
+		intervalHistory[cursor] = (float)(Scene::DeltaTime() * 1000.0);
+		cursor = (cursor + 1) % kHistory;
+		filled = Min(filled + 1, kHistory);
+
+		if (++windowFrames == kWindow) {
+			for (size_t i = 0; i < FrameProfiler::kMaxSections; ++i) {
+				avgMs[i] = sumMs[i] / kWindow;
+				sumMs[i] = 0.0;
+			}
+			windowFrames = 0;
+		}
+
+		if (KeyF4.down()) visible = !visible;
+		if (visible) draw();
 	}
 
-	void update() override {
-		// 先頭で一度コライダ算出 → player.update に渡す
-		const RectF colBody_pre = pencil.colliderBody();
-		const RectF colLead_pre = pencil.colliderLead();
+private:
+	static constexpr size_t kWindow = 60;
+	static constexpr size_t kHistory = 240;
+
+	static inline bool visible = false;
+	static inline std::array<double, FrameProfiler::kMaxSections> sumMs{}, avgMs{};
+	static inline std::array<uint16, FrameProfiler::kMaxSections> depths{};
+	static inline std::array<float, kHistory> cpuHistory{}, intervalHistory{};
+	static inline size_t cursor = 0, filled = 0, windowFrames = 0;
+
+	static double percentile(std::array<float, kHistory> v, const size_t n, const double q) {
+		if (n == 0) return 0.0;
+		const size_t k = Min(n - 1, (size_t)(q * n));
+		std::nth_element(v.begin(), v.begin() + k, v.begin() + n);
+		return v[k];
+	}
+
+	static void draw() {
+		const Font& f = Fonts::Stat();
+		const ColorF ink{ 0.1, 0.1, 0.1, 0.9 };
+		const double x0 = Scene::Width() - 320.0;
+		RectF{ x0 - 8, 0, 328, Scene::Height() }.draw(ColorF{ 1.0, 0.85 });
+
+		double y = 8;
+		f(U"frame p50 {:.1f} / p95 {:.1f} / p99 {:.1f} ms"_fmt(percentile(intervalHistory, filled, 0.50),
+			percentile(intervalHistory, filled, 0.95), percentile(intervalHistory, filled, 0.99))).draw(x0, y, ink);
+		y += 22;
+
+		// 処理時間（棒）と 16.7ms の線
+		const RectF graph{ x0, y, 300, 80 };
+		graph.draw(ColorF{ 0.9, 0.92, 0.95 });
+		const double barW = graph.w / kHistory;
+		for (size_t i = 0; i < filled; ++i) {
+			const float ms = cpuHistory[(cursor + kHistory - filled + i) % kHistory];
+			const double h = Min(graph.h, ms * (graph.h / 33.3));
+			RectF{ graph.x + i * barW, graph.bottomY() - h, barW, h }.draw(ms > 16.7f ? ColorF{ 0.85, 0.3, 0.3 } : ColorF{ 0.3, 0.55, 0.8 });
+		}
+		const double line = graph.bottomY() - graph.h * 0.5;
+		Line{ graph.x, line, graph.rightX(), line }.draw(1, ColorF{ 0.2, 0.5 });
+		y += graph.h + 8;
+
+		for (size_t i = 0; i < FrameProfiler::SectionCount(); ++i) {
+			if (avgMs[i] <= 0.0) continue;
+			f(Unicode::Widen(FrameProfiler::Name((uint16)i))).draw(x0 + depths[i] * 12, y, ink);
+			f(U"{:.3f} ms"_fmt(avgMs[i])).draw(Arg::topRight = Vec2{ x0 + 300, y }, ink);
+			y += 18;
+		}
+	}
+};
 
-		Array<RectF> dyn = platforms;
-		dyn << colBody_pre << colLead_pre << button;
-		dyn << RectF{ -100, 0, 100, (double)sceneSize.y }
-		<< RectF{ (double)sceneSize.x, 0, 100, (double)sceneSize.y };
+//============================= スプライトの図柄 =============================
+// アトラスに焼くもの。コマの大きさと基準点は各図柄の描画範囲に合わせてある
+static Array<SpriteAtlas::Figure> SpriteFigures() {
+	using Monkey = Stage1Sim::Monkey;
+	using Car = Stage4Sim::DepthCar;
+	const Size playerSize = Player{}.size;
+
+	// 車の大きさの段は Stage4 と同じ画面サイズの道路で決める
+	const RoadProjection road{ Stage4Sim{}.sceneSize };
+	Array<Size> carCells;
+	for (int32 i = 0; i < Car::kSpriteSizes; ++i) {
+		const Vec2 sz = Car::SpriteSize(road, i);
+		carCells << Size{ (int32)Math::Ceil(sz.x) + 1, (int32)Math::Ceil(sz.y * 1.3) + 1 };
+	}
 
-		player.update(dyn);
-		player.advanceAnim();
-		// === 折れた芯の落下更新 ===
-		brokenLead.update(Scene::DeltaTime());
+	return {
+		{ Sprite::Player, U"player", Size{ 56, 96 }, Vec2{ 28, 55 }, Player::kSpriteFrames,
+			[playerSize](DrawList& list, int32 i) { Player::PaintSpriteFrame(list, playerSize, i); } },
+		{ Sprite::MonkeyWalk, U"monkey walk", Size{ 64, 100 }, Vec2{ 32, 94 }, Monkey::kWalkFrames,
+			[](DrawList& list, int32 i) { Monkey::PaintWalking(list, Vec2{ 0, 0 }, Math::Sin(i * Math::TwoPi / Monkey::kWalkFrames) * 6.0); } },
+		{ Sprite::MonkeySit, U"monkey sit", Size{ 64, 100 }, Vec2{ 32, 94 }, Monkey::kSitFrames,
+			[](DrawList& list, int32 i) { Monkey::PaintSitting(list, Vec2{ 0, 0 }, i - 1); } },
+		{ Sprite::Fruit, U"fruit", Size{ 48, 48 }, Vec2{ 24, 26 }, 4,
+			[](DrawList& list, int32 i) { Monkey::PaintFruit(list, i, Vec2{ 0, 0 }); } },
+		// 影とタイヤが車体の下にはみ出すぶん、コマは車体の 1.3 倍の高さにする
+		{ Sprite::Car, U"car", Size{ 0, 0 }, Vec2{ 0, 0 }, Car::kSpriteSizes,
+			[road](DrawList& list, int32 i) { Car::Paint(list, RectF{ Vec2{ 0, 0 }, Car::SpriteSize(road, i) }); },
+			carCells },
+		{ Sprite::Door, U"door", Size{ 64, 84 }, Vec2{ 2, 2 }, 3,
+			[](DrawList& list, int32 i) { PaintDoor(list, RectF{ 0, 0, 60, 80 }, (DoorStyle)i); } },
+	};
+}
 
+//============================= ステージ基底 =============================
+// シミュレーション（Sim）を固定ステップで回し、描画と音だけを受け持つ
+template <class Sim>
+class StageBase : public App::Scene {
+protected:
+	RectF goal{ 840, 520, 80, 60 };
 
-		// ---- ボタン押下（交差開始 or 着地）＋クールダウン ----
-		const RectF playerAABB{ player.pos, player.size };   // ← ここで1回だけ定義
-		const bool  overlapNow = playerAABB.intersects(button.stretched(1));
-		const bool  enteredNow = (overlapNow && !buttonPrevOverlap);
-		const bool  landedBtn = landedFromJumpOn(button);   // ボタンは“着地”でもOK
-		if ((enteredNow || landedBtn)
-			&& (buttonCD.isRunning() == false || buttonCD.sF() >= buttonCooldown))
-		{
-			if (pencil.extendOnce()) {
-				AudioAsset(U"PushSE").play();
-			}
-			buttonCD.restart();
+	// ---- 入力の記録 / 再生 ----
+	InputTape tape;            // 記録中は毎 tick 追記、再生中は読み出し元
+	bool      playback = false;
+	size_t    tapeTick = 0;
+
+	Sim sim;                   // tape より後に初期化する（シードを tape から取る）
+
+	mutable DrawList drawList; // プレイヤーなど動くものはここに積んで submit でまとめて描く
+	size_t rssAtEnter = PeakRssBytes();
+
+	// ---- 固定ステップ（描画フレームと独立した 120Hz のシミュレーション）----
+	FixedStepper stepper;
+	bool   jumpLatch = false;  // 押した時刻の tick が来るまで押下を持ち越す
+	double jumpAt = 0.0;       // 押した時刻（sim の時刻）
+	bool   leaving = false;    // シーン遷移したら残りの tick は回さない
+
+	// 入力を1回サンプルし、溜まった時間ぶん tick を回す
+	void stepFixed() {
+		const PlayerInput sampled = SamplePlayerInput();
+		stepper.beginFrame(Scene::DeltaTime());
+
+		// 押した時刻を sim の時刻に直す（今 = simTime + stepper.accum）。まだ回していない tick より前には置かない。
+		// 時刻が取れなければこのフレームの最初の tick で押したことにする
+		if (sampled.jump && !jumpLatch) {
+			const Optional<uint64> at = JumpPresses::FirstThisFrame();
+			jumpAt = at ? Max(sim.simTime, sim.simTime + stepper.accum - (JumpPresses::FrameUs() - *at) * 1e-6) : sim.simTime;
+			jumpLatch = true;
 		}
-		buttonPrevOverlap = overlapNow;
 
-		// ---- 最新コライダ（延長後に更新）----
-		const RectF colBody = pencil.colliderBody();
-		const RectF colLead = pencil.colliderLead();
+		while (stepper.due() && !leaving && !sim.cleared) {
+			PlayerInput in = sampled;
+			in.jump = (jumpLatch && jumpAt < sim.simTime + SimTickDt);
+			if (in.jump) {
+				in.jumpSub = (uint8)Clamp((int)((jumpAt - sim.simTime) / SimTickDt * 16.0), 0, 15);
+				jumpLatch = false;
+			}
 
-		// === 折れる判定 ===
-		const double screenMidX = Scene::CenterF().x;  // 画面右半分しきい
-		const double prevCenterX = player.prevPos.x + player.size.x * 0.5;
-		const double nowCenterX = player.pos.x + player.size.x * 0.5;
+			if (playback && tapeTick < tape.ticks.size()) {
+				in = tape.at(tapeTick);   // 記録が尽きたら手動操作に戻る
+			}
+			else if (!playback) {
+				tape.record(in);
+			}
+			++tapeTick;
 
-		// 足元（接地/立っている判定用）← ここで1回だけ定義して以降も再利用
-		const RectF feet{ player.pos.x, player.pos.y + player.size.y - 2, player.size.x, 4 };
+			sim.step(in, SimTickDt);
+			stepper.consume();
 
-		// 条件1: 芯に“ジャンプから着地” → 折れる（根元の安全帯は除外）
-		if (landedFromJumpOn(colLead)) {
-			const double safeX = colLead.x + leadRootSafeLen;
-			if (nowCenterX >= safeX) {
-				breakLead();
-				goto AFTER_BREAK_CHECKS;
-			}
-		}
+			for (const auto e : sim.events) onSimEvent(e);
+			sim.events.clear();
 
-		// 条件3: プッシュ6回以上 & 画面右半分に到達 & grounded & 芯に“立っている” → 折れる
-		if (pencil.presses >= 6) {
-			const bool onLeadNowFeet = feet.intersects(colLead.stretched(0, 1));
-			const bool inRightHalfOfScreen = (nowCenterX >= screenMidX);
-			if (onLeadNowFeet && player.grounded && inRightHalfOfScreen) {
-				breakLead();
-				goto AFTER_BREAK_CHECKS;
+			if (sim.cleared) {
+				tape.cleared = !playback;
+				onClear();
+				break;
 			}
 		}
+		const double dropped = stepper.dropOverflow();
+		if (dropped > 0.0 && !leaving && !sim.cleared) onTicksDropped(dropped);
+		sim.player.interp = Saturate(stepper.accum / SimTickDt);
+	}
 
-	AFTER_BREAK_CHECKS:;
+	// 描画用の時刻（tick の端数まで進めたもの）
+	double renderTime() const { return sim.simTime + stepper.accum; }
 
-		// 衝撃演出（本体or芯上）
-		if (colBody.intersects(feet) || pencil.colliderLead().intersects(feet)) {
-			pencil.applyImpact(player.vel.y);
-		}
+	// クリア時のシーン遷移
+	void leaveTo(const State next, const Duration& transition) {
+		leaving = true;
+		changeScene(next, transition);
+	}
 
-		// 落下でリスポーン＆芯リセット
-		if (player.pos.y > sceneSize.y + 40) {
-			player.pos = startPos;
-			player.prevPos = startPos;
-			player.vel = Vec2{ 0, 0 };
-			pencil.reset();
-			buttonPrevOverlap = false;
-			wasOnLead = false;
+	// 再生の記録があれば受け取り、なければ新しいシードで記録を始める
+	uint64 takeSeed() {
+		auto& replay = getData().replay;
+		if (replay && (replay->stage == Sim::StageId)) {
+			tape = std::move(*replay);
+			replay.reset();
+			playback = true;
+			return tape.seed;
 		}
+		tape.stage = Sim::StageId;
+		tape.seed = RandomUint64();
+		return tape.seed;
+	}
 
-		// クリア
-		if (RectF{ player.pos, player.size }.intersects(door)) {
-			onClear();
-		}
+	// 直近のプレイをステージごとに1つ残す（不具合報告に添付してもらう）
+	void saveReplay() {
+		if (playback || tape.ticks.isEmpty()) return;
+		tape.hasFinal = true;
+		tape.finalPos = sim.player.pos;
+		FileSystem::CreateDirectories(U"Replays/");
+		tape.save(U"Replays/Stage{}.sinrep"_fmt(Sim::StageId).narrow().c_str());
+	}
 
-		if (KeyEscape.down()) {
-			StopAllAudio();
-			changeScene(State::Title, 0.2s);
+	// クリア済みの進行度を保存
+	void saveUnlocked(const int stage) {
+		getData().unlocked = Max(getData().unlocked, stage);
+		TextWriter writer{ U"Assets/SaveData.txt" };
+		if (writer)
+		{
+			writer.writeln(Format(getData().unlocked));
 		}
+		writer.close();
 	}
 
+	virtual void drawBackground() const {
+		Scene::SetBackground(ColorF{ 0.95, 0.98, 1.0 });
+	}
 
-	void drawBackground() const override {
-		Rect{ sceneSize }.draw(ColorF{ 0.97,0.98,1.0 });
-		for (int x = 0; x <= sceneSize.x; x += 40) Line{ x,0,x,sceneSize.y }.draw(1, ColorF{ 0,0,0,0.05 });
-		for (int y = 0; y <= sceneSize.y; y += 40) Line{ 0,y,sceneSize.x,y }.draw(1, ColorF{ 0,0,0,0.05 });
+	void drawLevel() const {
+		for (const auto& pf : sim.platforms) {
+			pf.draw(ColorF{ 0.75, 0.78, 0.82 });
+			pf.drawFrame(2, 0, ColorF{ 0.2, 0.25, 0.3, 0.4 });
+		}
 	}
 
-	void draw() const override {
-		drawBackground();
+	void uiCommon(const String& name) const {
+		(void)name;
+	}
 
-		// ドア島
-		doorPad.draw(ColorF{ 0.82,0.85,0.9 });
-		doorPad.drawFrame(2, 0, ColorF{ 0.2,0.25,0.3,0.4 });
+	// sim が Cleared を出した tick で呼ばれる
+	virtual void onClear() = 0;
 
-		// シャーペン（本体固定＋芯可変）
-		pencil.draw();
+	// sim のイベントを音にする（ステージ固有の鳴らし方があれば差し替える）
+	virtual void onSimEvent(const SimEvent e) { PlaySimEvent(e); }
+	// 処理落ちで sec 秒ぶんの tick を捨てた（sim がそのぶん実時間より遅れた）
+	virtual void onTicksDropped(double) {}
 
-		// 折れた芯（落下中）を描画
-		brokenLead.draw();
+public:
+	StageBase(const InitData& init)
+		: App::Scene{ init }, sim{ takeSeed() } {
+		if (!playback) tape.latencyUs = getData().inputLatencyUs;
+		sim.inputLatency = tape.latencySec();
+		SINLAND_PROF_MARK("scene Stage", Sim::StageId);
+		Preloader::Wait();
+		Preloader::MarkStageEnter(Sim::StageId);
+		LayerCache::ResetCounts();
+	}
 
-		// ボタン（ノック上）
-		RoundRect{ button, 3 }
-			.draw(ColorF{ 0.90,0.92,0.96 })
-			.drawFrame(2, ColorF{ 0.4,0.45,0.5,0.7 });
-		Triangle{ button.center().movedBy(0,-7), button.center().movedBy(-6,3), button.center().movedBy(6,3) }
-		.draw(ColorF{ 0.2,0.2,0.25,0.9 });
+	~StageBase() override {
+		saveReplay();
+		// 最大常駐メモリはプロセス全体で減らないので、入った時点との差も出す
+		const size_t peak = PeakRssBytes();
+		Logger << U"stage {}: peak rss {:.1f} MB (+{:.1f} MB in stage)"_fmt(
+			Sim::StageId, peak / 1048576.0, (peak - rssAtEnter) / 1048576.0);
+		LayerCache::LogCounts(Sim::StageId);
+	}
 
-		// ドア（共通 60×80）
-		door.draw(Palette::White);
-		door.drawFrame(4, ColorF{ 0.15,0.5,0.25 });
-		RectF{ door.x + 6, door.y + 6, door.w - 12, door.h - 12 }.draw(ColorF{ 0.85,1.0,0.9,0.35 });
+	void update() override {
+		SINLAND_PROF_SCOPE("StageBase::update");
+		stepFixed();
 
-		player.draw();
+		if (KeyEscape.down())
+		{
+			StopAllAudio();
+			changeScene(State::Title, 0.2s);
+		}
 	}
 
-	void onClear() override {
-		AudioAsset(U"clearSE").play();
-		getData().unlocked = Max(getData().unlocked, 4);
-		TextWriter writer{ U"Assets/SaveData.txt" };
-		if (writer) writer.writeln(Format(getData().unlocked));
-		writer.close();
-		StopAllAudio();
-		changeScene(State::Stage4, 0.5s);
+	void draw() const override {
+		SINLAND_PROF_SCOPE("StageBase::draw");
+		drawBackground();
+
+		drawLevel();
+		sim.player.draw(drawList);
+		drawList.submit();
 	}
 };
 
-//----------------------------- Stage4 -----------------------------
-class Stage4 : public StageBase {
-public:
-	using StageBase::StageBase;
-
-	Stage4(const InitData& init)
-		: StageBase(init)
-	{
-		platforms = {
-			RectF{ 0, crosswalk.y - 15, (double)sceneSize.x, (double)sceneSize.y - (crosswalk.y - 15) }
-		};
-		colliders = MakeLevelColliders(sceneSize, platforms);
+//---------------------------------- Stage1 -----------------------------
+class Stage1 : public StageBase<Stage1Sim> {
+private:
+	static void drawPad(const RectF& r, bool pressed) {
+		const ColorF base = pressed ? ColorF{ 0.65,0.7,0.75 } : ColorF{ 0.8,0.85,0.9 };
+		r.draw(base);
+		r.drawFrame(2, 0, ColorF{ 0.22,0.26,0.3,0.8 });
+		r.stretched(-6, -8).drawFrame(2, 0, ColorF{ 0.22,0.26,0.3,0.25 });
+	}
 
-		player = Player{};
-		player.pos = Vec2{ 120, 500 };
+public:
+	Stage1(const InitData& init) : StageBase(init) {
+		Sounds::Get(Sound::Stage1BGM).play();
+	}
 
-		goalDoor = RectF{ (double)sceneSize.x - 70.0, 470, 60, 80 };
 
-		AudioAsset::Register(U"carSE", U"Assets/carSE.mp3");
-		AudioAsset(U"carSE").setVolume(0.8);
-		AudioAsset::Register(U"car2SE", U"Assets/car2SE.mp3");
-		AudioAsset(U"car2SE").setVolume(0.8);
-		AudioAsset::Register(U"car3SE", U"Assets/car3SE.mp3");
-		AudioAsset(U"car3SE").setVolume(0.8);
-		AudioAsset::Register(U"green2SE", U"Assets/green2SE.mp3");
+	// 背景は木の実の並びが変わったときだけ描き直す
+	LayerCache background;
 
-		AudioAsset::Register(U"stage4BGM", U"Assets/stage4BGM.mp3");
-		AudioAsset(U"stage4BGM").setLoop(true);
-		AudioAsset(U"stage4BGM").setVolume(0.25);
-		AudioAsset(U"stage4BGM").play();
+	uint64 fruitsKey() const {
+		uint64 key = 0;
+		for (const int f : sim.fruits) key = (key << 4) | (uint64)f;
+		return key;
 	}
 
-private:
-	enum class Light { Red, Green };
+	void drawBackground() const override {
+		SINLAND_PROF_SCOPE("Stage1::drawBackground");
+		background.draw(fruitsKey(), [this] { paintBackground(); });
+	}
 
-	bool wasOnCrosswalk = false;
+	// --- 背景（森＋象徴の木＋横一列の木の実） ---
+	void paintBackground() const {
+		const double groundLineY = 560.0;
 
-	//============== 道路 ==============
-	static constexpr double roadYBottom = 580.0;
-	static constexpr double roadYTop = 360.0;
+		RectF{ 0,0,(double)sim.sceneSize.x,(double)sim.sceneSize.y }
+		.draw(Arg::top = ColorF{ 0.88,0.95,1.0 }, Arg::bottom = ColorF{ 0.82,0.93,0.86 });
 
-	static constexpr double walkLeft = 220.0;
-	static constexpr double walkRight = 70.0;
+		// 奥の森
+		{
+			const ColorF farTree{ 0.45,0.55,0.45,0.35 };
+			for (int i = 0; i < 14; ++i) {
+				const double bx = (i * 80.0) + (i % 3 * 12.0);
+				const double cy = 140.0 + (i % 4 * 8.0);
+				Circle{ bx + 38, cy + 0, 70 }.draw(farTree);
+				Circle{ bx + 14, cy + 20, 60 }.draw(farTree);
+				Circle{ bx + 60, cy + 28, 58 }.draw(farTree);
+				RectF{ bx + 30, cy + 40, 24, groundLineY - (cy + 40) }.draw(farTree);
+			}
+		}
+		// 手前の森（薄め）
+		{
+			const ColorF nearTree{ 0.35,0.45,0.35,0.4 };
+			for (int i = 0; i < 10; ++i) {
+				const double bx = (i * 110.0) + ((i % 2) * 25.0);
+				const double cy = 100.0 + (i % 3 * 10.0);
+				Circle{ bx + 38, cy - 20, 90 }.draw(nearTree);
+				Circle{ bx + 8, cy + 10, 75 }.draw(nearTree);
+				Circle{ bx + 70, cy + 18, 70 }.draw(nearTree);
+				RectF{ bx + 28, cy + 30, 24, groundLineY - (cy + 30) }.draw(nearTree);
+			}
+		}
 
-	static constexpr double topScale = 0.42;
+		// 象徴の木
+		{
+			const double cx = sim.sceneSize.x * 0.5;
+			const double crownBaseY = 180.0;
+			const double trunkW = 48.0;
+			const ColorF leaf{ 0.16,0.24,0.16,0.8 }, trunk{ 0.10,0.16,0.10,0.85 };
 
-	double W() const { return (double)Scene::Width(); }
-	double H() const { return (double)Scene::Height(); }
+			Circle{ Vec2{cx - 60,crownBaseY + 20},70 }.draw(leaf);
+			Circle{ Vec2{cx + 60,crownBaseY + 20},70 }.draw(leaf);
+			Circle{ Vec2{cx,   crownBaseY - 10},80 }.draw(leaf);
+			Circle{ Vec2{cx - 90,crownBaseY + 50},60 }.draw(leaf);
+			Circle{ Vec2{cx + 90,crownBaseY + 50},60 }.draw(leaf);
 
-	double vanishCX() const { return W() * 0.54; }
+			const double tTop = crownBaseY + 40, tBot = 560;
+			RectF{ cx - trunkW * 0.5, tTop, trunkW, tBot - tTop }.draw(trunk);
+			Circle{ Vec2{ cx - trunkW * 0.7, tTop + 20 }, 30 }.draw(leaf);
+			Circle{ Vec2{ cx + trunkW * 0.7, tTop + 20 }, 30 }.draw(leaf);
+		}
 
-	double roadLeftBottomX()  const { return walkLeft; }
-	double roadRightBottomX() const { return W() - walkRight; }
+		// 木の実（横一列）
+		for (size_t i = 0; i < sim.fruits.size(); ++i) {
+			Stage1Sim::Monkey::DrawFruit(drawList, sim.fruits[i], sim.fruitSlots[i]);
+		}
+		drawList.submit();
 
-	double roadLeftTop()  const {
-		const double bottomW = roadRightBottomX() - roadLeftBottomX();
-		const double topHalf = (bottomW * topScale) * 0.5;
-		return vanishCX() - topHalf;
+		// 地面帯＋薄霧
+		RectF{ 0, groundLineY, sim.sceneSize.x, (double)sim.sceneSize.y - groundLineY }.draw(ColorF{ 0.06,0.08,0.06,0.8 });
+		RectF{ 0, 0, sim.sceneSize.x, sim.sceneSize.y }.draw(ColorF{ 1,1,1,0.04 });
 	}
-	double roadRightTop() const {
-		const double bottomW = roadRightBottomX() - roadLeftBottomX();
-		const double topHalf = (bottomW * topScale) * 0.5;
-		return vanishCX() + topHalf;
+
+	void update() override
+	{
+		SINLAND_PROF_SCOPE("Stage1::update");
+		stepFixed();
+
+		if (!sim.clearing && !leaving && KeyEscape.down()) {
+			Sounds::Get(Sound::Monkey).stop();
+			StopAllAudio();
+			changeScene(State::Title, 0.2s);
+		}
 	}
 
-	double edgeLeftX(double y)  const {
-		const double t = (y - roadYTop) / (roadYBottom - roadYTop);
-		return Math::Lerp(roadLeftTop(), roadLeftBottomX(), t);
-	}
-	double edgeRightX(double y) const {
-		const double t = (y - roadYTop) / (roadYBottom - roadYTop);
-		return Math::Lerp(roadRightTop(), roadRightBottomX(), t);
-	}
 
-	RectF crossTrigger{ 270, 510, 550, 100 }; // {X, Y, Width, Height}
+	// --- 描画（レイヤー順：背景 → 地面 → サル（奥） → パッド/扉 → プレイヤー（手前）） ---
+	void draw() const override
+	{
+		SINLAND_PROF_SCOPE("Stage1::draw");
+		drawBackground();
+		drawLevel();
+		sim.monkey.draw(drawList);
+		drawList.submit();
 
-	bool wasInCrossTrigger = false;
+		drawPad(sim.swSwap, sim.swSwapPrev);
+		drawPad(sim.swRotate, sim.swRotatePrev);
 
-	bool   controlLocked = false;
-	double respawnTimer = 0.0;
+		if (sim.doorAppeared) {
+			DrawDoor(drawList, sim.door, DoorStyle::Inset);
+		}
 
-	bool overlapsWorld(const RectF& r) const {
-		for (const auto& c : colliders) {
-			if (r.intersects(c)) return true;
+		sim.player.draw(drawList);
+		drawList.submit();
+
+		if (sim.fadeInAlpha > 0.0) {
+			RectF{ 0,0, (double)sim.sceneSize.x, (double)sim.sceneSize.y }.draw(ColorF{ 0,0,0, sim.fadeInAlpha });
+		}
+		if (sim.clearing) {
+			const double a = Saturate(sim.clearT / sim.fadeOutSec);
+			RectF{ 0,0, (double)sim.sceneSize.x, (double)sim.sceneSize.y }.draw(ColorF{ 0,0,0, a });
 		}
-		return false;
 	}
 
-	Light prevLight = Light::Red;
-
-	bool isInCrossTrigger(const RectF& r) const {
-		return r.intersects(crossTrigger);
+	void onClear() override {
+		saveUnlocked(2);
+		StopAllAudio();
+		leaveTo(State::Stage2, 0s);
 	}
+};
 
 
-	//============== 車 ==============
-	struct DepthCar {
-		double y = roadYTop - 60.0;
-		double speed = 780.0;
-		bool   active = false;
+//----------------------------- Stage2 -----------------------------
+class Stage2 : public StageBase<Stage2Sim> {
+public:
+	using StageBase::StageBase;
 
-		double widthFrac = 0.38;
-		double baseHeightBottom = 120.0;
+	~Stage2() override {
+		const OffsetStats& e = beats.onsetErrorUs();
+		if (e.n == 0) return;
+		// 鼓動の時刻（時計）と、ループの再生位置から出した時刻とのずれ。再生位置はミキサーのバッファ単位
+		Logger << U"stage 2: beat onset vs loop position  mean {:.0f} us / jitter {:.0f} us / max {:.0f} us ({} frames)"_fmt(
+			e.mean(), e.jitter(), e.max, e.n);
+	}
 
-		double laneT = 0.33;
+private:
+	// 1拍ぶんの Wave の決まった位置に鼓動を置いてループ再生し、その再生位置を拍の時計にする。
+	// 拍ごとにフレームから play() しないので、鼓動は出力のサンプル単位で等間隔に鳴る
+	class BeatTrack {
+	public:
+		// beatTime = startTime の瞬間に鳴らし始める。onset は1拍の中で鼓動が鳴る時刻
+		void start(const Wave& beat, const double period, const double onset, const double startTime, const double volume) {
+			frameMode = beat.isEmpty();
+			if (frameMode) {
+				// Wave に展開されていない（PcmMaxFileBytes より大きい・読めない）ときは、
+				// 以前と同じく拍が来たフレームで鼓動の音を play() する（フレーム単位の精度）
+				Logger << U"heartbeat: no PCM, falling back to per-frame play()";
+				framePeriod = period;
+				frameOnset = onset;
+				frameBeat = Math::Floor((startTime - onset) / period);
+				clock.set(startTime);
+				return;
+			}
+			rate = beat.sampleRate();
+			length = Max<size_t>((size_t)Math::Round(period * rate), 1);
+
+			Wave loop = beat;
+			loop.resize(length);
+			std::fill(loop.begin(), loop.end(), WaveSample{ 0.0f, 0.0f });
+			// 先頭が startTime になるよう鼓動の位置をずらす。1拍より長い音は先頭に回り込ませて重ねる
+			const double lead = onset - startTime;
+			const size_t at = (size_t)Math::Round((lead - Math::Floor(lead / period) * period) * rate) % length;
+			for (size_t i = 0; i < beat.size(); ++i) {
+				WaveSample& d = loop[(at + i) % length];
+				d.left += beat[i].left;
+				d.right += beat[i].right;
+			}
 
-		std::function<double(double)> edgeL;
-		std::function<double(double)> edgeR;
+			audio = Audio{ loop };
+			audio.setVolume(volume);
+			audio.setLoop(true);
+			audio.play();
+			clock.start(startTime, rate, length);
+			fresh = true;
+		}
 
-		void spawnFar() {
-			y = roadYTop - 80.0;
-			active = true;
+		void stop() {
+			if (frameMode) { frameMode = false; Sounds::Get(Sound::Heartbeat).stop(); }
+			if (audio) audio.stop();
 		}
-		void update(double dt) {
-			if (!active) return;
-			y += speed * dt;
-			if (y > roadYBottom + 220.0) active = false;
+		bool playing() const { return (audio && audio.isPlaying()); }
+
+		// 再生位置を拍の時刻 t に合わせ直す（sim が処理落ちで遅れたとき、音を sim に合わせる）
+		void resync(const double t) {
+			if (!playing()) return;
+			audio.seekSamples(clock.positionAt(t));
+			clock.set(t);
+			fresh = true;
 		}
 
-		// 遠近補正：道路Y→画面Y
-		double projectY(double roadY) const {
-			const double t = (roadY - roadYTop) / (roadYBottom - roadYTop);
-			return Math::Lerp(roadYTop, roadYBottom, t);
+		// 毎フレーム呼ぶ。鳴っていない間は fallback（sim の時刻）に従う。
+		// measure なら、時計が示す鼓動の時刻と再生位置から出した時刻とのずれを集計する
+		void update(const double dt, const double fallback, const bool measure = true) {
+			if (frameMode) {
+				const double beatIndex = Math::Floor((fallback - frameOnset) / framePeriod);
+				if (beatIndex > frameBeat) Sounds::Get(Sound::Heartbeat).play();
+				frameBeat = beatIndex;
+			}
+			if (!playing()) { clock.set(fallback); return; }
+
+			// 鳴らし始めた・合わせ直したフレームでは時計はもう今を指しているので、経過時間を足さない
+			clock.update(std::exchange(fresh, false) ? 0.0 : dt, audio.posSample());
+			if (!measure) return;
+			onsetError.add((clock.time() - clock.sampleTime()) * 1e6);
 		}
 
-		// 投影矩形
-		RectF projectedRect() const {
-			const double screenY = projectY(y);
+		double time() const { return clock.time(); }
+
+		const OffsetStats& onsetErrorUs() const { return onsetError; }
 
-			const double l = edgeL(screenY);
-			const double r = edgeR(screenY);
-			const double wRoad = Max(0.0, r - l);
+	private:
+		Audio  audio;
+		uint32 rate = 1;
+		size_t length = 1;        // 1拍のサンプル数
+		BeatClock clock;
+		bool   fresh = false;       // start / resync の直後（次の update で時計を進めない）
 
-			const double w = wRoad * widthFrac;
+		// PCM がないときの代わり（拍が来たフレームで鳴らす）
+		bool   frameMode = false;
+		double framePeriod = 1.0, frameOnset = 0.0, frameBeat = 0.0;
 
-			const double cx = Math::Lerp(l, r, laneT);
+		OffsetStats onsetError;
+	};
+
+	// 心臓の形は原点・基準の大きさで一度だけ作り、鼓動は拡大率で付ける
+	static constexpr double kHeartSize = 170.0;
+	enum : uint64 { HeartOuter, HeartInner };
+	MeshCache meshes;
+	BeatTrack beats;
 
-			const double depth = Saturate((screenY - roadYTop) / (roadYBottom - roadYTop));
-			const double h = Max(12.0, baseHeightBottom * Math::Lerp(0.35, 1.0, depth));
+	// ---- 入力の遅れの測定（C キー）----
+	// sim を止めて鼓動だけを鳴らし、ジャンプキーを kCalibTaps 回押してもらう。
+	// 鳴った時刻から押した時刻までのずれの中央値を保存し、ステージを最初からやり直す
+	static constexpr size_t kCalibTaps = 12;
+	bool calibrating = false;
+	Array<double> calibTaps;
 
-			const double top = screenY - h;
-			return RectF{ cx - w * 0.5, top, w, h };
+	void updateCalibration() {
+		if (KeyEscape.down()) {
+			// やめたら止めていた sim の時刻から鼓動を鳴らし直す
+			calibrating = false;
+			beats.start(Sounds::GetPcm(Sound::Heartbeat), sim.period(), sim.heartbeatOffset(), sim.beatTime(),
+				SoundManifest[(size_t)Sound::Heartbeat].volume);
+			return;
 		}
+		if (!(KeySpace.down() || KeyW.down() || KeyUp.down())) return;
+
+		const Optional<uint64> at = JumpPresses::FirstThisFrame();
+		const double age = at ? (JumpPresses::FrameUs() - *at) * 1e-6 : 0.0;
+		const double p = sim.period();
+		double d = (beats.time() - age) - sim.heartbeatOffset();
+		d -= p * Math::Round(d / p);   // 一番近い鼓動からのずれ
+		calibTaps << d;
+		if (calibTaps.size() < kCalibTaps) return;
+
+		std::sort(calibTaps.begin(), calibTaps.end());
+		const double latency = Clamp(calibTaps[calibTaps.size() / 2], 0.0, 0.3);
+		getData().inputLatencyUs = (int32)Math::Round(latency * 1e6);
+		TextWriter writer{ U"Assets/Calibration.txt" };
+		if (writer) writer.writeln(Format(getData().inputLatencyUs));
+		writer.close();
+		Logger << U"calibration: input latency {:.1f} ms (taps {:.1f} .. {:.1f} ms)"_fmt(
+			latency * 1000.0, calibTaps.front() * 1000.0, calibTaps.back() * 1000.0);
 
-		void draw() const {
-			if (!active) return;
-			const RectF r = projectedRect();
-			const double w = r.w, h = r.h;
+		calibrating = false;
+		beats.stop();
+		leaveTo(State::Stage2, 0.3s);
+	}
 
-			// 影
-			Ellipse{ r.center().movedBy(0, h * 0.55), w * 0.42, h * 0.22 }
-			.draw(ColorF(0, 0, 0, 0.08));
+	void onSimEvent(const SimEvent e) override {
+		switch (e) {
+		case SimEvent::StartHeartbeat:
+			// 鳴り始めるのは今（tick の端数まで進めた時刻）
+			beats.start(Sounds::GetPcm(Sound::Heartbeat), sim.period(), sim.heartbeatOffset(), renderTime() - sim.t0,
+				SoundManifest[(size_t)Sound::Heartbeat].volume);
+			break;
+		case SimEvent::StopHeartbeat:
+			beats.stop();
+			break;
+		default:
+			PlaySimEvent(e);
+			break;
+		}
+	}
 
-			// ==== ボディ（正面）====
-			// ロアボディ
-			RoundRect lower = RectF(r.x + 4, r.y + h * 0.65, w - 8, h * 0.30).rounded(10);
-			lower.draw(ColorF(0.07));
+	// 判定は sim の時刻で行うので、sim が遅れたら鼓動の音（と描画の時計）を sim の方へ戻す
+	void onTicksDropped(double) override { beats.resync(sim.beatTime()); }
 
-			// キャビン
-			RoundRect cab = RectF(r.x + w * 0.06, r.y + h * 0.05, w * 0.88, h * 0.62).rounded(12);
-			cab.draw(ColorF(0.18));
-			RectF(cab.rect.x + 6, cab.rect.y + 6, cab.rect.w - 12, cab.rect.h - 12)
-				.rounded(10).draw(ColorF(0.93));
+public:
+	void update() override {
+		SINLAND_PROF_SCOPE("Stage2::update");
+		if (calibrating) {
+			beats.update(Scene::DeltaTime(), beats.time(), false);
+			updateCalibration();
+			return;
+		}
+		if (KeyC.down() && beats.playing() && !playback && !leaving) {
+			calibrating = true;
+			calibTaps.clear();
+			return;
+		}
 
-			// フロントガラス
-			RoundRect windshield = RectF(r.x + w * 0.20, r.y + h * 0.10, w * 0.60, h * 0.28).rounded(10);
-			windshield.draw(ColorF(0.09, 0.12, 0.16, 0.85));
-			// 反射ハイライト
-			Quad(
-				windshield.rect.tl().movedBy(6, 6),
-				windshield.rect.tr().movedBy(-18, 4),
-				windshield.rect.tr().movedBy(-8, windshield.rect.h * 0.40),
-				windshield.rect.tl().movedBy(10, windshield.rect.h * 0.45)
-			).draw(ColorF(1, 1, 1, 0.06));
+		StageBase::update();
+		if (KeyEscape.down()) beats.stop();
+		// 鼓動・ゲージの描画はすべてこの時計で読む
+		beats.update(Scene::DeltaTime(), renderTime() - sim.t0);
+	}
 
-			// ボンネットのハイライト
-			RoundRect hood = RectF(r.x + w * 0.10, r.y + h * 0.48, w * 0.80, h * 0.12).rounded(8);
-			hood.draw(ColorF(1, 1, 1, 0.08));
+	// 心臓
+	void drawBackground() const override
+	{
+		RectF{ 0,0,(double)sim.sceneSize.x,(double)sim.sceneSize.y }
+		.draw(Arg::top = ColorF{ 0.92,0.96,1.0 }, Arg::bottom = ColorF{ 1.0,0.92,0.96 });
 
-			// グリル
-			RoundRect grill = RectF(r.x + w * 0.22, r.y + h * 0.66, w * 0.56, h * 0.08).rounded(6);
-			grill.draw(ColorF(0.06));
+		const double beat = sim.beatEnvelope(beats.time());
+		const double scale = 1.0 + 0.03 * beat;
 
-			// ヘッドライト
-			const double lampW = w * 0.12;
-			const double lampH = h * 0.10;
-			RoundRect lampL = RectF(r.x + w * 0.06, r.y + h * 0.63, lampW, lampH).rounded(6);
-			RoundRect lampR = RectF(r.x + w * 0.82, r.y + h * 0.63, lampW, lampH).rounded(6);
-			lampL.draw(ColorF(1.0, 0.95, 0.75, 0.95));
-			lampR.draw(ColorF(1.0, 0.95, 0.75, 0.95));
+		const Vec2   C = Vec2{ sim.sceneSize.x * 0.5, sim.sceneSize.y * 0.48 };
+		const double S = kHeartSize;   // 以下は原点・基準の大きさで描き、鼓動は pulse で付ける
 
-			// フォグ
-			RoundRect fogL = RectF(r.x + w * 0.18, r.y + h * 0.74, w * 0.16, h * 0.06).rounded(4);
-			RoundRect fogR = RectF(r.x + w * 0.66, r.y + h * 0.74, w * 0.16, h * 0.06).rounded(4);
-			fogL.draw(ColorF(0.9, 0.95, 1.0, 0.18));
-			fogR.draw(ColorF(0.9, 0.95, 1.0, 0.18));
+		Ellipse{ C.movedBy(10, 18), 140 * scale, 46 * scale }.draw(ColorF{ 0,0,0,0.08 });
 
-			// バンパー下のスリット
-			RectF(r.x + w * 0.28, r.y + h * 0.73, w * 0.44, h * 0.035).rounded(3).draw(ColorF(0.1));
+		const Polygon& heart = meshes.get(HeartOuter, [] { return Shape2D::Heart(kHeartSize, Vec2{ 0, 0 }).asPolygon(); }).polygon;
+		const Polygon& inner = meshes.get(HeartInner, [] { return Shape2D::Heart(kHeartSize, Vec2{ 0, 0 }).asPolygon().scaled(0.92); }).polygon;
 
-			// タイヤ
-			const double wheelR = h * 0.16;
-			Circle(r.x + w * 0.18, r.y + h * 0.98, wheelR).draw(ColorF(0.05));
-			Circle(r.x + w * 0.82, r.y + h * 0.98, wheelR).draw(ColorF(0.05));
-		}
-	};
+		// 線の太さは拡大率で割って元の太さに戻す
+		const Transformer2D pulse{ Mat3x2::Scale(scale).translated(C) };
+		heart.draw(ColorF{ 0.90, 0.25, 0.35 });
+		inner.draw(ColorF{ 0.85, 0.18, 0.30, 0.9 });
+		heart.drawFrame(4 / scale, ColorF{ 0.70, 0.10, 0.20, 0.35 });
 
+		const double a = 0.20 + 0.10 * beat;
+		Ellipse{ Vec2{ -S * 0.25, -S * 0.20 }, S * 0.55, S * 0.38 }.draw(ColorF{ 1.0, 0.95, 0.98, a * 0.7 });
+		Ellipse{ Vec2{ -S * 0.10, -S * 0.30 }, S * 0.25, S * 0.18 }.draw(ColorF{ 1.0, 1.0, 1.0, a * 0.35 });
 
-	//============== 配置 ==============
-	const Vec2  startPos{ 120, 540 };
-	const RectF crosswalk{ 360, 560, 240, 24 }; // 横断歩道
-	const RectF sensor{ 176, 520, 1, 44 };      // センサー
-	RectF goalDoor{ 0, 450, 60, 80 };
+		const ColorF tube{ 0.75, 0.18, 0.28, 0.7 };
 
-	//============== 信号 / タイミング ==============
-	Light  light = Light::Red;
-	double senseHold = 0.0;
-	static constexpr double kHoldToGreen = 2.0; // 青に必要な滞在秒
-	static constexpr double kGreenWindow = 3.5; // 青の持続秒
-	double greenRemain = 0.0;
-	bool   goalAppeared = false;
+		BezierCache::Draw(Bezier2{ Vec2{ -S * 0.08, -S * 0.55 }, Vec2{ -S * 0.22, -S * 0.68 }, Vec2{ -S * 0.35, -S * 0.50 } }, 10 / scale, tube);
+		BezierCache::Draw(Bezier2{ Vec2{ S * 0.05, -S * 0.55 }, Vec2{ S * 0.22, -S * 0.70 }, Vec2{ S * 0.34, -S * 0.56 } }, 8 / scale, tube);
 
-	//============== 車制御（奥→手前） ==============
-	DepthCar carA{}, carB{};  
-	bool   carQueued = false;
-	double carSpawnDelay = 0.18;
-	double carSpawnT = 0.0;
+		heart.drawFrame(14 / scale, ColorF{ 1.0, 0.6, 0.7, 0.06 });
+	}
 
-	//============== ヘルパ ==============
-	RectF playerRect() const { return RectF{ player.pos, player.size }; }
-	void warpPlayerToStart() {
-		const double safeY = groundY - player.size.y - 2.0;
-		player.pos = Vec2{ startPos.x, Min(startPos.y, safeY) };
-		player.vel = Vec2{ 0, 0 };
 
-		for (int i = 0; i < 10 && overlapsWorld(RectF{ player.pos, player.size }); ++i) {
-			player.pos.y -= 2.0;
+	// 描画順：背景（心臓）→ 地面 → ゴール → プレイヤー
+	void draw() const override {
+		SINLAND_PROF_SCOPE("Stage2::draw");
+		drawBackground();
+		drawLevel();
+
+		// --- リズムゲージ ---
+		{
+			const Vec2 base = Vec2{ Scene::CenterF().x - 200, 24 };
+			const double w = 36, h = 10, gap = 6;
+			for (int i = 0; i < sim.kGoalCombo; ++i) {
+				const RectF r{ base.x + i * (w + gap), base.y, w, h };
+				if (i < sim.combo) {
+					r.stretched(0, 2).draw(ColorF{ 0.9, 0.2, 0.3, 0.9 });
+				}
+				else {
+					r.draw(ColorF{ 0.92, 0.92, 0.95, 0.7 });
+					r.drawFrame(1.5, ColorF{ 0.5, 0.5, 0.6, 0.6 });
+				}
+			}
+			const double t = beats.time();
+			const double p = (t * sim.heartHz) - Math::Floor(t * sim.heartHz);
+			const double x = base.x + (w + gap) * (sim.kGoalCombo * Math::Clamp(p, 0.0, 1.0));
+			Line{ x, base.y - 6, x, base.y + h + 6 }.draw(2, ColorF{ 0.8,0.3,0.4,0.25 });
 		}
-	}
+		if (sim.doorAppeared) {
+			DrawDoor(drawList, sim.door, DoorStyle::Glass);
+		}
+		sim.player.draw(drawList);
 
-	void resetAfterHit() {
-		carA.active = false;
-		carB.active = false;
-		carQueued = false;
-		carSpawnT = 0.0;
-		warpPlayerToStart();
-		controlLocked = true;
-		respawnTimer = 0.5;
-		knocked = false;
-		wasOnCrosswalk = false;
-		senseHold = 0.0;
+		if (calibrating) {
+			drawList.addTextAt(Fonts::UI(), U"キャリブレーション：鼓動に合わせてジャンプキー {}/{}"_fmt(calibTaps.size(), kCalibTaps),
+				Vec2{ Scene::CenterF().x, 80 }, ColorF{ 0.25 });
+		}
+		else if (!sim.doorAppeared) {
+			drawList.addTextAt(Fonts::UI(), U"C：入力の遅れを測る", Vec2{ 110, 620 }, ColorF{ 0.4, 0.6 });
+		}
+		drawList.submit();
 	}
 
-	// 轢かれ演出
-	bool  knocked = false;
-	Vec2  knockVel{ 0, 0 };
-	static constexpr double gravityY = 1600.0;
-	static constexpr double groundY = 560.0;
-
-	void drawBackgroundPerspective() const;
+	void onClear() override {
+		saveUnlocked(3);
+		beats.stop();
+		StopAllAudio();
+		leaveTo(State::Stage3, 0.5s);
+	}
+};
 
+//----------------------------- Stage3 -----------------------------
+class Stage3 : public StageBase<Stage3Sim> {
 public:
-	void update() override {
-		const double dt = Scene::DeltaTime();
+	using StageBase::StageBase;
 
-		// リスポーン凍結
-		if (respawnTimer > 0.0) {
-			respawnTimer -= dt;
-			if (respawnTimer <= 0.0) { controlLocked = false; respawnTimer = 0.0; }
-		}
-		if (!controlLocked) { StageBase::update(); }
+	LayerCache background;
 
-		const RectF prect{ player.pos, player.size };
+	void drawBackground() const override {
+		background.draw(0, [this] { paintBackground(); });
+	}
 
-		const bool inCross = isInCrossTrigger(prect);
-		const bool enteredCrossThisFrame = (inCross && !wasInCrossTrigger);
-		wasInCrossTrigger = inCross;
+	void paintBackground() const {
+		Rect{ sim.sceneSize }.draw(ColorF{ 0.97,0.98,1.0 });
+		for (int x = 0; x <= sim.sceneSize.x; x += 40) Line{ x,0,x,sim.sceneSize.y }.draw(1, ColorF{ 0,0,0,0.05 });
+		for (int y = 0; y <= sim.sceneSize.y; y += 40) Line{ 0,y,sim.sceneSize.x,y }.draw(1, ColorF{ 0,0,0,0.05 });
+	}
 
-		const Light before = light;
+	void draw() const override {
+		SINLAND_PROF_SCOPE("Stage3::draw");
+		drawBackground();
 
-		// 車の投影関数とレーン
-		carA.edgeL = [this](double y) { return this->edgeLeftX(y); };
-		carA.edgeR = [this](double y) { return this->edgeRightX(y); };
-		carA.laneT = 0.33;
-		carB.edgeL = [this](double y) { return this->edgeLeftX(y); };
-		carB.edgeR = [this](double y) { return this->edgeRightX(y); };
-		carB.laneT = 0.67;
+		// ドア島
+		sim.doorPad.draw(ColorF{ 0.82,0.85,0.9 });
+		sim.doorPad.drawFrame(2, 0, ColorF{ 0.2,0.25,0.3,0.4 });
 
-		// --- センサー：滞在で青化 ---
-		{
-			const double px = prect.center().x;
-			const double sx = sensor.center().x;
-			const double distX = Abs(px - sx);
-			constexpr double kSensorThreshold = 3.5;
+		// シャーペン（本体固定＋芯可変）
+		sim.pencil.draw();
 
-			if (distX < kSensorThreshold
-				&& prect.y < sensor.y + sensor.h
-				&& prect.y + prect.h > sensor.y) {
-				senseHold = Min(senseHold + dt, kHoldToGreen);
-				if (senseHold >= kHoldToGreen && light == Light::Red) {
-					light = Light::Green;
-					greenRemain = kGreenWindow;
-					AudioAsset(U"green2SE").setVolume(0.3);
-					AudioAsset(U"green2SE").play();
-				}
-			}
-			else {
-				senseHold = Max(0.0, senseHold - dt * 0.7);
-			}
-		}
+		// 折れた芯（落下中）を描画
+		sim.brokenLeads.draw(ColorF{ 0.1, 0.1, 0.12, 0.95 });
 
-		// --- 青の残り ---
-		if (light == Light::Green) {
-			greenRemain -= dt;
-			if (greenRemain <= 0.0) { light = Light::Red; senseHold = 0.0; }
-		}
+		// ボタン（ノック上）
+		RoundRect{ sim.button, 3 }
+			.draw(ColorF{ 0.90,0.92,0.96 })
+			.drawFrame(2, ColorF{ 0.4,0.45,0.5,0.7 });
+		Triangle{ sim.button.center().movedBy(0,-7), sim.button.center().movedBy(-6,3), sim.button.center().movedBy(6,3) }
+		.draw(ColorF{ 0.2,0.2,0.25,0.9 });
 
-		if (light == Light::Red && enteredCrossThisFrame) {
-			if (!carA.active && !carB.active) {
-				carA.spawnFar(); carB.spawnFar();
-				AudioAsset(U"car3SE").play();
-			}
-		}
+		DrawDoor(drawList, sim.door, DoorStyle::Solid);
 
-		const bool turnedToRedThisFrame = (before == Light::Green && light == Light::Red);
-		if (turnedToRedThisFrame && inCross) {
-			if (!carA.active && !carB.active) {
-				carA.spawnFar(); carB.spawnFar();
-				AudioAsset(U"car3SE").play();
-			}
-		}
+		sim.player.draw(drawList);
+		drawList.submit();
+	}
 
-		// 車
-		carA.update(dt);
-		carB.update(dt);
+	void onClear() override {
+		saveUnlocked(4);
+		StopAllAudio();
+		leaveTo(State::Stage4, 0.5s);
+	}
+};
 
-		// 衝突
-		if (!knocked && (carA.active || carB.active)) {
-			if ((carA.active && carA.projectedRect().intersects(prect)) ||
-				(carB.active && carB.projectedRect().intersects(prect))) {
-				knocked = true; controlLocked = true; player.vel = Vec2{ 0,0 };
-				knockVel = Vec2(Random(-120.0, 120.0), -560.0);
-				StopAllAudio();
-				AudioAsset(U"carSE").play();
-				AudioAsset(U"car2SE").play();
-			}
-		}
+//----------------------------- Stage4 -----------------------------
+class Stage4 : public StageBase<Stage4Sim> {
+public:
+	Stage4(const InitData& init) : StageBase(init) {
+		Sounds::Get(Sound::Stage4BGM).play();
+	}
 
-		// ゴール判定
-		if (!controlLocked && prect.intersects(goalDoor)) {
-			StopAllAudio();
-			AudioAsset(U"stage4BGM").stop();
-			changeScene(State::StageLast, 0.3s);
-		}
+private:
+	LayerCache background;   // 道路・歩道・横断歩道は動かない
+
+	void drawBackgroundPerspective() const;
+
+public:
+	void update() override {
+		SINLAND_PROF_SCOPE("Stage4::update");
+		StageBase::update();
 
-		// ノックバック物理
-		if (knocked) {
-			knockVel.y += gravityY * dt;
-			player.pos += knockVel * dt;
-			if (player.pos.y + player.size.y > groundY) {
-				player.pos.y = groundY - player.size.y; knockVel.y = 0.0;
-			}
-			if (!carA.active && !carB.active) {
-				resetAfterHit();
-				return;
-			}
-		}
 		if (KeyEscape.down()) {
-			StopAllAudio();
-			AudioAsset(U"stage4BGM").stop();
-			return;
+			Sounds::Get(Sound::Stage4BGM).stop();
 		}
 	}
 
 	void draw() const override {
-		drawBackgroundPerspective();
+		SINLAND_PROF_SCOPE("Stage4::draw");
+		background.draw(0, [this] { drawBackgroundPerspective(); });
 
-		// 上部 ゲージ
+		// 上部 ゲージ。車やプレイヤーより下に描く（上を通ると隠れる）。
+		// DrawList は文字をレイヤーの図形より後に出すので、信号機までをここで一度 submit してから車を積む
 		{
 			const Vec2 base = Vec2{ Scene::CenterF().x - 180, 24 };
 			const double Wb = 360, Hb = 16;
 
-			RectF(base.x, base.y, Wb, Hb).draw(ColorF(0.95, 0.97, 1.0, 0.85));
-			RectF(base.x, base.y, Wb, Hb).drawFrame(2, 0, ColorF(0.25, 0.3, 0.35, 0.7));
+			drawList.add(RectF(base.x, base.y, Wb, Hb), ColorF(0.95, 0.97, 1.0, 0.85));
+			drawList.addFrame(RectF(base.x, base.y, Wb, Hb), 2, 0, ColorF(0.25, 0.3, 0.35, 0.7));
 
-			if (light == Light::Red) {
-				const double p = (kHoldToGreen > 0 ? (senseHold / kHoldToGreen) : 1.0);
-				RectF(base.x, base.y, Wb * Saturate(p), Hb).draw(ColorF(0.35, 0.85, 0.75, 0.9));
-				FontAsset(U"ui")(U"センサー充電中").drawAt(base.movedBy(Wb * 0.5, -14), ColorF(0.25));
+			if (sim.light == Stage4Sim::Light::Red) {
+				const double p = (sim.kHoldToGreen > 0 ? (sim.senseHold / sim.kHoldToGreen) : 1.0);
+				drawList.add(RectF(base.x, base.y, Wb * Saturate(p), Hb), ColorF(0.35, 0.85, 0.75, 0.9));
+				drawList.addTextAt(Fonts::UI(), U"センサー充電中", base.movedBy(Wb * 0.5, -14), ColorF(0.25));
 			}
 			else {
-				const double p = Saturate(greenRemain / kGreenWindow);
-				RectF(base.x, base.y, Wb * p, Hb).draw(ColorF(0.35, 1.0, 0.45, 0.9));
-				FontAsset(U"ui")(Format(U"青信号 {:.1f}s", greenRemain))
-					.drawAt(base.movedBy(Wb * 0.5, -14), ColorF(0.25));
+				const double p = Saturate(sim.greenRemain / sim.kGreenWindow);
+				drawList.add(RectF(base.x, base.y, Wb * p, Hb), ColorF(0.35, 1.0, 0.45, 0.9));
+				drawList.addTextAt(Fonts::UI(), Format(U"青信号 {:.1f}s", sim.greenRemain),
+					base.movedBy(Wb * 0.5, -14), ColorF(0.25));
 			}
 		}
 
 		// 信号機（右歩道側）
 		{
 			const double baseX = Scene::Width() - 120.0;
-			const double baseY = crosswalk.y - 20.0;
+			const double baseY = sim.crosswalk.y - 20.0;
 			const Vec2 poleBase{ baseX, baseY };
 
-			RectF(poleBase.movedBy(-4, -120), 8, 140).draw(ColorF(0.1, 0.1, 0.1));
+			drawList.add(RectF(poleBase.movedBy(-4, -120), 8, 140), ColorF(0.1, 0.1, 0.1));
 			const RectF box = RectF(poleBase.movedBy(-44, -180), 40, 90);
-			box.rounded(4).draw(ColorF(0.08, 0.08, 0.08));
+			drawList.add(box.rounded(4), ColorF(0.08, 0.08, 0.08));
 
 			const double r = 10.0;
 			const Vec2 redPos = box.center().movedBy(0, -24);
@@ -1957,49 +4574,49 @@ public:
 			const ColorF redOn(1.0, 0.25, 0.25), redOff(0.25, 0.08, 0.08);
 			const ColorF greenOn(0.35, 1.0, 0.45), greenOff(0.05, 0.25, 0.08);
 
-			Circle(redPos, r).draw((light == Light::Red) ? redOn : redOff);
-			Circle(yellowPos, r).draw(ColorF(0.15));
-			Circle(greenPos, r).draw((light == Light::Green) ? greenOn : greenOff);
+			drawList.add(Circle(redPos, r), (sim.light == Stage4Sim::Light::Red) ? redOn : redOff);
+			drawList.add(Circle(yellowPos, r), ColorF(0.15));
+			drawList.add(Circle(greenPos, r), (sim.light == Stage4Sim::Light::Green) ? greenOn : greenOff);
 
-			if (light == Light::Red)   Circle(redPos, r * 1.8).draw(ColorF(1.0, 0.3, 0.3, 0.25));
-			if (light == Light::Green) Circle(greenPos, r * 1.8).draw(ColorF(0.4, 1.0, 0.5, 0.25));
+			if (sim.light == Stage4Sim::Light::Red)   drawList.add(Circle(redPos, r * 1.8), ColorF(1.0, 0.3, 0.3, 0.25));
+			if (sim.light == Stage4Sim::Light::Green) drawList.add(Circle(greenPos, r * 1.8), ColorF(0.4, 1.0, 0.5, 0.25));
 
-			if (light == Light::Green) {
-				FontAsset(U"ui")(Format(U"{:.1f}", greenRemain)).drawAt(poleBase.movedBy(-20, -200), ColorF(0.9));
+			if (sim.light == Stage4Sim::Light::Green) {
+				drawList.addTextAt(Fonts::UI(), Format(U"{:.1f}", sim.greenRemain), poleBase.movedBy(-20, -200), ColorF(0.9));
 			}
 		}
+		drawList.submit();   // ゲージ・信号機の文字を車より先に出す
 
-		carA.draw();
-		carB.draw();
+		for (const auto& car : sim.cars) car.draw(sim.road, drawList);
 
-		{
-			goalDoor.draw(Palette::White);
-			goalDoor.drawFrame(4, ColorF{ 0.15,0.5,0.25 });
-			RectF{ goalDoor.x + 6, goalDoor.y + 6, goalDoor.w - 12, goalDoor.h - 12 }
-			.draw(ColorF{ 0.85,1.0,0.9,0.35 });
-		}
+		DrawDoor(drawList, sim.goalDoor, DoorStyle::Solid);
 
-		player.draw();
+		sim.player.draw(drawList);
+		drawList.submit();
 
 		// デバッグ用
 		//crossTrigger.draw(ColorF(0, 1, 0, 0.25));
 	}
 
-	void onClear() override {}
+	void onClear() override {
+		leaveTo(State::StageLast, 0.3s);
+	}
 };
 
 // 遠近背景（奥行きに沿った横断歩道）
 void Stage4::drawBackgroundPerspective() const {
-	const double Wv = W(), Hv = H();
+	SINLAND_PROF_SCOPE("Stage4::drawBackgroundPerspective");
+	const RoadProjection& rp = sim.road;
+	const double Wv = rp.W(), Hv = rp.H();
 
 	// 歩道（左右の薄い台形）
 	const Quad sideL{
-		Vec2{0, roadYBottom}, Vec2{roadLeftBottomX(), roadYBottom},
-		Vec2{roadLeftTop(), roadYTop}, Vec2{0, roadYTop}
+		Vec2{0, rp.roadYBottom}, Vec2{rp.roadLeftBottomX(), rp.roadYBottom},
+		Vec2{rp.roadLeftTop(), rp.roadYTop}, Vec2{0, rp.roadYTop}
 	};
 	const Quad sideR{
-		Vec2{roadRightBottomX(), roadYBottom}, Vec2{Wv, roadYBottom},
-		Vec2{Wv, roadYTop}, Vec2{roadRightTop(), roadYTop}
+		Vec2{rp.roadRightBottomX(), rp.roadYBottom}, Vec2{Wv, rp.roadYBottom},
+		Vec2{Wv, rp.roadYTop}, Vec2{rp.roadRightTop(), rp.roadYTop}
 	};
 
 	// 背景空
@@ -2009,16 +4626,16 @@ void Stage4::drawBackgroundPerspective() const {
 
 	// 道路
 	const Quad road{
-		Vec2{roadLeftBottomX(),  roadYBottom},
-		Vec2{roadRightBottomX(), roadYBottom},
-		Vec2{roadRightTop(),     roadYTop},
-		Vec2{roadLeftTop(),      roadYTop}
+		Vec2{rp.roadLeftBottomX(),  rp.roadYBottom},
+		Vec2{rp.roadRightBottomX(), rp.roadYBottom},
+		Vec2{rp.roadRightTop(),     rp.roadYTop},
+		Vec2{rp.roadLeftTop(),      rp.roadYTop}
 	};
 	road.draw(ColorF(0.14));
 
 	// 近景の横断歩道（遠近つきの白線）
-	const double bandTop = crosswalk.y - 40.0;
-	const double bandBottom = crosswalk.y + crosswalk.h + 8.0;
+	const double bandTop = sim.crosswalk.y - 40.0;
+	const double bandBottom = sim.crosswalk.y + sim.crosswalk.h + 8.0;
 	{
 		const int stripes = 8;
 		const double gapFrac = 1.0 / (stripes * 2.0);
@@ -2027,8 +4644,8 @@ void Stage4::drawBackgroundPerspective() const {
 			const double f1 = (i * 2 + 1) * gapFrac;
 
 			const double yA = bandTop, yB = bandBottom;
-			const double lA = edgeLeftX(yA), rA = edgeRightX(yA);
-			const double lB = edgeLeftX(yB), rB = edgeRightX(yB);
+			const double lA = rp.edgeLeftX(yA), rA = rp.edgeRightX(yA);
+			const double lB = rp.edgeLeftX(yB), rB = rp.edgeRightX(yB);
 
 			const Vec2 A0{ Math::Lerp(lA, rA, f0), yA };
 			const Vec2 A1{ Math::Lerp(lA, rA, f1), yA };
@@ -2040,9 +4657,9 @@ void Stage4::drawBackgroundPerspective() const {
 
 	// 奥の横断歩道（飾り）
 	{
-		const double yT0 = roadYTop + 12, yT1 = yT0 + 12;
-		const double l0 = edgeLeftX(yT0), r0 = edgeRightX(yT0);
-		const double l1 = edgeLeftX(yT1), r1 = edgeRightX(yT1);
+		const double yT0 = rp.roadYTop + 12, yT1 = yT0 + 12;
+		const double l0 = rp.edgeLeftX(yT0), r0 = rp.edgeRightX(yT0);
+		const double l1 = rp.edgeLeftX(yT1), r1 = rp.edgeRightX(yT1);
 		for (int i = 0; i < 6; ++i) {
 			const double f0 = (i * 2) / 12.0;
 			const double f1 = (i * 2 + 1) / 12.0;
@@ -2060,50 +4677,41 @@ void Stage4::drawBackgroundPerspective() const {
 }
 
 //----------------------------- StageLast -----------------------------
-class StageLast : public StageBase {
+class StageLast : public StageBase<StageLastSim> {
 public:
-	using StageBase::StageBase;
-
-private:
-	// 家具当たり/描画用
-	RectF chairArea{ 860, 540, 60, 40 };   // イス座面
-	RectF deskArea{ 820, 520, 120, 20 };  // デスク天板
-	RectF pcRect{ 880, 470,  40, 28 };  // モニタ
-	RectF towerRect{ 830, 540,  20, 40 };  // PC本体
-	RectF decoStep{ 720, 560,  80, 20 };
-
-	bool  sitting = false;
-	bool  clicked = false;
-	bool  blackedOut = false;
-	Stopwatch sitSW{ StartImmediately::No };
-	Stopwatch blackoutSW{ StartImmediately::No };
+	StageLast(const InitData& init) : StageBase(init) {
+		goal = RectF{};
 
-	const double blackoutDelay = 2.1;   // 暗転開始（即時黒）
-	const double holdBlack = 0.20;  // 黒を見せる時間
-	const double clickLead = 0.25;  // シーン遷移までの時間
+		Sounds::Get(Sound::StageLastBGM).play();
+	}
 
+	// 窓の星だけは毎フレーム瞬くので焼き込まない
+	LayerCache background;
+	const RectF window{ 360, 180, 180, 120 };
 
-public:
-	StageLast(const InitData& init) : StageBase(init) {
-		platforms = { RectF{ 0, 580, 960, 60 } };
-		colliders = MakeLevelColliders(sceneSize, platforms);
+	// 星の配置は記録と同じシードで決める（再生しても同じ空になる）
+	const ParticleField stars{ ParticleField::Desc{
+		.area = window.stretched(-10), .count = 18,
+		.minRadius = 1.2, .maxRadius = 2.2, .minAlpha = 0.3, .maxAlpha = 0.6,
+		.color = ColorF{ 1.0, 1.0, 0.9 } }, tape.seed };
 
-		player = Player{};
-		player.pos = Vec2{ 40, 540 };
-		goal = RectF{};
+	void drawBackground() const override {
+		background.draw(0, [this] { paintBackground(); });
+		drawWindow();
+	}
 
-		AudioAsset::Register(U"clickSE", U"Assets/clickSE.mp3");
-		AudioAsset::Register(U"stageLastBGM", U"Assets/stageLastBGM.mp3");
-		AudioAsset(U"stageLastBGM").setLoop(true);
-		AudioAsset(U"stageLastBGM").setVolume(0.2);
-		AudioAsset(U"stageLastBGM").play();
+	void drawWindow() const {
+		stars.draw(renderTime());
+		window.drawFrame(4, ColorF{ 0.6,0.65,0.7 });
+		Line{ window.x, window.centerY(), window.x + window.w, window.centerY() }.draw(2, ColorF{ 0.6,0.65,0.7,0.7 });
+		Line{ window.centerX(), window.y, window.centerX(), window.y + window.h }.draw(2, ColorF{ 0.6,0.65,0.7,0.7 });
 	}
 
-	void drawBackground() const override {
-		RectF{ 0,0,(double)sceneSize.x,(double)sceneSize.y }
+	void paintBackground() const {
+		RectF{ 0,0,(double)sim.sceneSize.x,(double)sim.sceneSize.y }
 		.draw(Arg::top = ColorF{ 0.94,0.95,0.98 }, Arg::bottom = ColorF{ 0.90,0.92,0.96 });
-		RectF{ 0, 560, (double)sceneSize.x, 80 }.draw(ColorF{ 0.80,0.83,0.86 });
-		Line{ 0,560, sceneSize.x,560 }.draw(2, ColorF{ 0.5,0.55,0.6,0.35 });
+		RectF{ 0, 560, (double)sim.sceneSize.x, 80 }.draw(ColorF{ 0.80,0.83,0.86 });
+		Line{ 0,560, sim.sceneSize.x,560 }.draw(2, ColorF{ 0.5,0.55,0.6,0.35 });
 
 		{
 			const RectF bedBase{ 100, 520, 220, 40 };
@@ -2114,22 +4722,10 @@ public:
 			RectF{ bedBase.x + 150, bedBase.y - 16, 60, 16 }.draw(ColorF{ 0.95,0.95,0.98 });
 		}
 
-		{
-			const RectF window{ 360, 180, 180, 120 };
-			window.draw(ColorF{ 0.15,0.18,0.30 });
-			for (int i = 0; i < 18; ++i) {
-				Circle{ window.pos.movedBy(Random(10.0, window.w - 10.0),
-										   Random(10.0, window.h - 10.0)),
-						Random(1.2, 2.2) }
-				.draw(ColorF{ 1.0,1.0,0.9, Random(0.3,0.6) });
-			}
-			window.drawFrame(4, ColorF{ 0.6,0.65,0.7 });
-			Line{ window.x, window.centerY(), window.x + window.w, window.centerY() }.draw(2, ColorF{ 0.6,0.65,0.7,0.7 });
-			Line{ window.centerX(), window.y, window.centerX(), window.y + window.h }.draw(2, ColorF{ 0.6,0.65,0.7,0.7 });
-		}
+		window.draw(ColorF{ 0.15,0.18,0.30 });
 
 		{
-			const RectF seat = chairArea;
+			const RectF seat = sim.chairArea;
 			seat.draw(ColorF{ 0.78,0.80,0.84 });
 			seat.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.7 });
 			RectF{ seat.x + 6, seat.y - 24, 10, 24 }.draw(ColorF{ 0.6,0.65,0.7 }); // 背
@@ -2141,21 +4737,21 @@ public:
 
 
 		{
-			deskArea.draw(ColorF{ 0.82,0.84,0.88 });
-			deskArea.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.6 });
-			RectF{ deskArea.x + 6, deskArea.y + deskArea.h, 8, 40 }.draw(ColorF{ 0.6,0.65,0.7 });
-			RectF{ deskArea.x + deskArea.w - 14, deskArea.y + deskArea.h, 8, 40 }.draw(ColorF{ 0.6,0.65,0.7 });
+			sim.deskArea.draw(ColorF{ 0.82,0.84,0.88 });
+			sim.deskArea.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.6 });
+			RectF{ sim.deskArea.x + 6, sim.deskArea.y + sim.deskArea.h, 8, 40 }.draw(ColorF{ 0.6,0.65,0.7 });
+			RectF{ sim.deskArea.x + sim.deskArea.w - 14, sim.deskArea.y + sim.deskArea.h, 8, 40 }.draw(ColorF{ 0.6,0.65,0.7 });
 
-			pcRect.draw(ColorF{ 0.10,0.11,0.12 });
-			RectF{ pcRect.x + 4, pcRect.y + 4, pcRect.w - 8, pcRect.h - 8 }
+			sim.pcRect.draw(ColorF{ 0.10,0.11,0.12 });
+			RectF{ sim.pcRect.x + 4, sim.pcRect.y + 4, sim.pcRect.w - 8, sim.pcRect.h - 8 }
 			.draw(Arg::top = ColorF{ 0.9,0.95,1.0,0.9 }, Arg::bottom = ColorF{ 0.75,0.85,1.0,0.9 });
-			pcRect.drawFrame(2, ColorF{ 0.6,0.65,0.7,0.8 });
-			Ellipse{ pcRect.center().movedBy(0,8), 60, 18 }.draw(ColorF{ 0.8,0.9,1.0,0.08 });
+			sim.pcRect.drawFrame(2, ColorF{ 0.6,0.65,0.7,0.8 });
+			Ellipse{ sim.pcRect.center().movedBy(0,8), 60, 18 }.draw(ColorF{ 0.8,0.9,1.0,0.08 });
 
-			towerRect.draw(ColorF{ 0.22,0.24,0.28 });
-			towerRect.drawFrame(2, ColorF{ 0.55,0.6,0.66,0.5 });
-			RectF{ towerRect.x + 6, towerRect.y + 8, towerRect.w - 12, 6 }.draw(ColorF{ 0.85,0.2,0.2 });
-			Circle{ towerRect.x + 14, towerRect.y + towerRect.h - 10, 3 }.draw(ColorF{ 0.2,0.9,0.3 });
+			sim.towerRect.draw(ColorF{ 0.22,0.24,0.28 });
+			sim.towerRect.drawFrame(2, ColorF{ 0.55,0.6,0.66,0.5 });
+			RectF{ sim.towerRect.x + 6, sim.towerRect.y + 8, sim.towerRect.w - 12, 6 }.draw(ColorF{ 0.85,0.2,0.2 });
+			Circle{ sim.towerRect.x + 14, sim.towerRect.y + sim.towerRect.h - 10, 3 }.draw(ColorF{ 0.2,0.9,0.3 });
 
 			{
 				Line{ 640, 560, 640, 500 }.draw(3, ColorF{ 0.6,0.65,0.7 });
@@ -2165,116 +4761,40 @@ public:
 
 		}
 
-		decoStep.draw(ColorF{ 0.76,0.79,0.82 });
-		decoStep.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.5 });
+		sim.decoStep.draw(ColorF{ 0.76,0.79,0.82 });
+		sim.decoStep.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.5 });
 	}
 
 	void update() override {
-		const double dt = Scene::DeltaTime();
-
+		SINLAND_PROF_SCOPE("StageLast::update");
 		if (KeyEscape.down()) {
 			StopAllAudio();
 			changeScene(State::Title, 0.2s);
 			return;
 		}
 
-		if (!sitting) {
-			const bool left = (KeyA.pressed() || KeyLeft.pressed());
-			const bool right = (KeyD.pressed() || KeyRight.pressed());
-
-			double ax = 0.0;
-			if (left ^ right) {
-				const double a = player.grounded ? player.moveAccel * 0.8 : player.airAccel * 0.8;
-				ax = (left ? -a : a);
-			}
-			const double maxX = player.maxSpeedX * 0.7;
-
-			player.prevPos = player.pos;
-
-			player.vel.x += ax * dt;
-			player.vel.x -= player.vel.x * Min((player.grounded ? player.groundFric : player.airFric) * dt, 1.0);
-			player.vel.x = Clamp(player.vel.x, -maxX, maxX);
-			// 縦は重力（着地維持・ジャンプ禁止）
-			player.vel.y += player.gravity * dt;
-
-			player.pos.x += player.vel.x * dt;
-			{
-				RectF aabbX{ player.pos, player.size };
-				for (const auto& c : colliders) {
-					if (!aabbX.intersects(c)) continue;
-					if (player.vel.x > 0) player.pos.x = c.x - player.size.x - 0.01;
-					else if (player.vel.x < 0) player.pos.x = c.x + c.w + 0.01;
-					player.vel.x = 0; aabbX.setPos(player.pos);
-				}
-			}
-			player.pos.y += player.vel.y * dt;
-			{
-				RectF aabbY{ player.pos, player.size };
-				player.grounded = false;
-				for (const auto& c : colliders) {
-					if (!aabbY.intersects(c)) continue;
-					if (player.vel.y > 0) { player.pos.y = c.y - player.size.y - 0.01; player.vel.y = 0; player.grounded = true; }
-					else if (player.vel.y < 0) { player.pos.y = c.y + c.h + 0.01; player.vel.y = 0; }
-					aabbY.setPos(player.pos);
-				}
-			}
-			player.jumpedThisFrame = false;
-			player.advanceAnim();
-
-			const RectF playerAABB{ player.pos, player.size };
-			if (playerAABB.intersects(chairArea)) {
-				sitting = true;
-				AudioAsset(U"stageLastBGM").stop();
-				player.vel = Vec2{ 0,0 };
-				player.pos = Vec2{ chairArea.x + 14, chairArea.y - player.size.y + 12 };
-
-				sitSW.restart();
-			}
-		}
-		else {
-			const double t = sitSW.sF();
-
-			const double clickAt = Max(0.0, blackoutDelay - clickLead);
-			if (!clicked && t >= clickAt) {
-				clicked = true;
-				if (AudioAsset::IsRegistered(U"clickSE")) AudioAsset(U"clickSE").play();
-			}
-			if (!blackedOut && t >= blackoutDelay) {
-				blackedOut = true;
-				blackoutSW.restart();
-			}
-			if (blackedOut && blackoutSW.sF() >= holdBlack) {
-				getData().unlocked = Max(getData().unlocked, 13);
-				TextWriter writer{ U"Assets/SaveData.txt" };
-				if (writer)
-				{
-					writer.writeln(Format(getData().unlocked));
-				}
-				writer.close();
-				StopAllAudio();
-				changeScene(State::EndRoll, 0.0s);
-				return;
-			}
-		}
-	};
+		stepFixed();
+	}
 
 	void draw() const override {
+		SINLAND_PROF_SCOPE("StageLast::draw");
 		drawBackground();
 		drawLevel();
 
-		if (!sitting) {
-			player.draw();
+		if (!sim.sitting) {
+			sim.player.draw(drawList);
+			drawList.submit();
 		}
 		else {
-			const Vec2 center = player.pos + Vec2{ player.size } / 2;
+			const Vec2 center = sim.player.pos + Vec2{ sim.player.size } / 2;
 
-			Ellipse{ center.movedBy(8, player.size.y / 2 + 12), 20, 7 }.draw(ColorF{ 0,0,0,0.12 });
+			Ellipse{ center.movedBy(8, sim.player.size.y / 2 + 12), 20, 7 }.draw(ColorF{ 0,0,0,0.12 });
 			const RoundRect body{ RectF{ Arg::center = center.movedBy(12, -4), 26, 30 }, 6.0 };
 			{
 				const Transformer2D tilt{ Mat3x2::Rotate(0.10, body.rect.center()) };
 				body.draw(ColorF{ 0.12,0.12,0.14 });
 			}
-			const Circle head{ center.movedBy(18, -player.size.y * 0.9 + 8), 12 };
+			const Circle head{ center.movedBy(18, -sim.player.size.y * 0.9 + 8), 12 };
 			head.draw(ColorF{ 0.95 });
 			Circle{ head.center.movedBy(3, -2), 1.6 }.draw(ColorF{ 0.08 });
 			Line{ body.rect.center().movedBy(2,-6), body.rect.center().movedBy(18,-10) }.draw(4, ColorF{ 0.15 });
@@ -2283,7 +4803,7 @@ public:
 			Line{ body.rect.bottomCenter().movedBy(8,-2), body.rect.bottomCenter().movedBy(20,10) }.draw(5, ColorF{ 0.12 });
 			Circle{ body.rect.bottomCenter().movedBy(-18, 12), 4 }.draw(ColorF{ 0.2 });
 			Circle{ body.rect.bottomCenter().movedBy(22, 12), 4 }.draw(ColorF{ 0.2 });
-			RectF seatLip{ chairArea.x, chairArea.y + chairArea.h - 5, chairArea.w, 5 };
+			RectF seatLip{ sim.chairArea.x, sim.chairArea.y + sim.chairArea.h - 5, sim.chairArea.w, 5 };
 			seatLip.draw(ColorF{ 0.74,0.76,0.80 });
 			seatLip.drawFrame(1.5, ColorF{ 0.5,0.55,0.6,0.7 });
 		}
@@ -2299,19 +4819,23 @@ public:
 			const RectF pot{ 520, 586, 26, 16 };
 			pot.draw(ColorF{ 0.7,0.5,0.4 });
 			for (int i = 0; i < 4; ++i) {
-				Bezier2{ pot.center().movedBy(0,-2),
+				BezierCache::Draw(Bezier2{ pot.center().movedBy(0,-2),
 						 pot.center().movedBy(-18 + 12 * i,-22),
-						 pot.center().movedBy(-10 + 10 * i,-36) }.draw(4, ColorF{ 0.25,0.5,0.3,0.9 });
+						 pot.center().movedBy(-10 + 10 * i,-36) }, 4, ColorF{ 0.25,0.5,0.3,0.9 });
 			}
 
 			RectF{ 220, 588, 36, 14 }.draw(ColorF{ 0.82,0.84,0.88 });
 			RectF{ 220, 588, 36, 14 }.drawFrame(2, ColorF{ 0.5,0.55,0.6,0.6 });
 		}
-		if (sitting && blackedOut) {
+		if (sim.sitting && sim.blackedOut) {
 			RectF(Scene::Rect()).draw(ColorF{ 0,0,0 });
 		}
 	}
-	void onClear() override {}
+
+	void onClear() override {
+		saveUnlocked(13);
+		leaveTo(State::EndRoll, 0.0s);
+	}
 };
 
 
@@ -2350,11 +4874,13 @@ private:
 
 public:
 	EndRoll(const InitData& init) : IScene(init) {
+		SINLAND_PROF_MARK("scene EndRoll", 0);
 		StopAllAudio();
 		Scene::SetBackground(ColorF{ 0,0,0 });
 	}
 
 	void update() override {
+		SINLAND_PROF_SCOPE("EndRoll::update");
 		if (KeyEscape.down()) {
 			StopAllAudio();
 			changeScene(State::Title, 0.3s);
@@ -2371,6 +4897,7 @@ public:
 	}
 
 	void draw() const override {
+		SINLAND_PROF_SCOPE("EndRoll::draw");
 		Rect(Scene::Rect()).draw(ColorF{ 0,0,0 });
 
 		if (index >= (int)slides.size()) return;
@@ -2385,18 +4912,42 @@ public:
 		}
 		alpha = Saturate(alpha);
 
-		static const Font fBig{ 36 };
 		const Vec2 center = Scene::CenterF();
-		fBig(slides[index]).drawAt(center, ColorF{ 1,1,1, alpha });
+		Fonts::EndRoll()(slides[index]).drawAt(center, ColorF{ 1,1,1, alpha });
 	}
 };
 
 //============================= Main =============================
 void Main() {
+	const Stopwatch startup{ StartImmediately::Yes };
+	const auto args = System::GetCommandLineArgs();
+
+	// --replay <file> : 記録したプレイをそのステージから等速で再生
+	// --trace <file>  : 計測区間を Chrome のトレース形式で書き出す
+	// --measure-se    : 効果音の play() から鳴り始めまでの時間を測ってログに出す（起動時に数秒かかる）
+	Optional<InputTape> replay;
+	for (size_t i = 0; i + 1 < args.size(); ++i) {
+		if (args[i] == U"--trace") {
+			if (!TraceRecorder::Start(args[i + 1])) Logger << U"trace: cannot open {}"_fmt(args[i + 1]);
+			continue;
+		}
+		if (args[i] != U"--replay") continue;
+		InputTape t;
+		if (t.load(args[i + 1].narrow().c_str())) replay = std::move(t);
+	}
+
 	System::SetTerminationTriggers(UserAction::CloseButtonClicked);
 	Window::Resize(960, 640);
 	Window::SetTitle(U"Sin Land");
 
+	// 音とフォントはタイトルを出している間に読む
+	Preloader::Begin(startup);
+	JumpPresses::Start();
+	if (args.includes(U"--measure-se")) {
+		Preloader::Wait();
+		Sounds::MeasureLatency();
+	}
+
 	int unlockedValue = 1;
 
 	TextReader reader{ U"Assets/SaveData.txt" };
@@ -2425,6 +4976,23 @@ void Main() {
 	}
 	reader.close();
 
+	// Stage2 で測った入力の遅れ（マイクロ秒）
+	int32 inputLatencyUs = -1;
+	TextReader calib{ U"Assets/Calibration.txt" };
+	if (calib)
+	{
+		String line;
+		if (calib.readLine(line))
+		{
+			line = line.trimmed();
+			if (!line.isEmpty() && std::all_of(line.begin(), line.end(), [](const char32 ch) { return IsDigit(ch); }))
+			{
+				inputLatencyUs = Parse<int32>(line);
+			}
+		}
+	}
+	calib.close();
+
 	App manager;
 	manager.add<Title>(State::Title);
 	manager.add<Select>(State::Select);
@@ -2436,11 +5004,685 @@ void Main() {
 	manager.add<StageLast>(State::StageLast);
 	manager.add<EndRoll>(State::EndRoll);
 
-	manager.init(State::Title);
+	State first = State::Title;
+	if (replay) {
+		switch (replay->stage) {
+		case Stage1Sim::StageId:    first = State::Stage1; break;
+		case Stage2Sim::StageId:    first = State::Stage2; break;
+		case Stage3Sim::StageId:    first = State::Stage3; break;
+		case Stage4Sim::StageId:    first = State::Stage4; break;
+		case StageLastSim::StageId: first = State::StageLast; break;
+		default: replay.reset(); break;
+		}
+		manager.get()->replay = replay;
+	}
+
+	manager.init(first);
 
 	manager.get()->unlocked = unlockedValue;
+	manager.get()->inputLatencyUs = inputLatencyUs;
+
+	// キャラや小物のアトラスはタイトルを出している間に焼く
+	SpriteAtlas::Begin(SpriteFigures());
 
 	while (System::Update()) {
-		manager.update();
+		{
+			SINLAND_PROF_SCOPE("frame");
+			const Stopwatch frameSW{ StartImmediately::Yes };
+			JumpPresses::BeginFrame();
+			Preloader::Update();
+			SpriteAtlas::Update();
+			{
+				SINLAND_PROF_SCOPE("manager.update");
+				manager.update();
+			}
+			Preloader::EndFrame(frameSW.msF());
+			DrawRenderStats();
+		}
+		ProfilerOverlay::EndFrame();
+	}
+
+	TraceRecorder::Stop();
+}
+
+# else // SINLAND_HEADLESS
+
+//============================= ヘッドレス実行 =============================
+//   ./sinland_headless [ticks]               各ステージを固定入力で回し、1ms あたりの tick 数・クリア有無・ヒープ確保数を出す
+//                                            （最後に 5万粒のパーティクル更新の時間も出す）
+//   ./sinland_headless --replay a.sinrep ...  記録を流し直し、記録時と同じ tick・同じ位置で終わるか確かめる
+//                                            （test/replays/ に各ステージをクリアする記録を置いてある）
+//   ./sinland_bench --bench [frames] [--stress k] [--sims n] [--replay a.sinrep ...]
+//                                            ステージごとの1フレーム（60fps = 2 tick）の時間・確保数・ヒープ最大量を
+//                                            1行1ステージの JSON で出す（コミット間の比較用）。
+//                                            --stress は果物・芯の破片・車・タイトルの輪を k 倍に、--sims は sim を n 個同時に回す
+//   ./sinland_headless --check-beat           Stage2 の拍の時計が処理落ちや長い停止の後も音とそろうか確かめる（鼓動の時刻のずれを µs で出す）
+//   ./sinland_micro --micro [名前の一部]         当たり判定・投影・拍まわりの関数を1回あたりの ns で測る
+//   ./sinland_bench --bench-broadphase        密度一定のまま足場を増やし、1クエリの時間をグリッドと全件走査で比べる（CSV）
+
+// ヒープ確保の回数（tick 中に new が走っていないかを数える）と、確保中のバイト数・その最大
+static size_t g_heapAllocs = 0;
+static size_t g_heapBytes = 0;
+static size_t g_heapPeak = 0;
+
+// 確保した大きさを先頭に置いておき、解放時に引く
+struct alignas(std::max_align_t) HeapHeader { std::size_t bytes; };
+
+void* operator new(std::size_t bytes) {
+	++g_heapAllocs;
+	if (auto* h = static_cast<HeapHeader*>(std::malloc(sizeof(HeapHeader) + bytes))) {
+		h->bytes = bytes;
+		g_heapBytes += bytes;
+		g_heapPeak = std::max(g_heapPeak, g_heapBytes);
+		return h + 1;
+	}
+	throw std::bad_alloc{};
+}
+// 呼び出し側に展開されると GCC が「確保先の手前を読んでいる」と誤検知して警告するので、展開させない
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+	if (!p) return;
+	auto* h = static_cast<HeapHeader*>(p) - 1;
+	g_heapBytes -= h->bytes;
+	std::free(h);
+}
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+static PlayerInput ScriptedInput(const int tick) {
+	PlayerInput in;
+	in.right = ((tick / 240) % 4) != 3;           // 2秒右・0.5秒左…を繰り返す
+	in.left = !in.right;
+	in.jump = (tick % 90 == 0);
+	return in;
+}
+
+template <class Sim>
+static void RunHeadless(const char* name, const int ticks) {
+	constexpr int kWarmupTicks = 120 * 5;   // 配列の容量やセルが出揃うまでは確保を数えない
+
+	Sim sim{ 1 };
+	size_t events = 0, allocs = 0;
+	int done = 0;
+
+	const auto t0 = std::chrono::steady_clock::now();
+	for (; done < ticks && !sim.cleared; ++done) {
+		const size_t before = g_heapAllocs;
+		sim.step(ScriptedInput(done), SimTickDt);
+		events += sim.events.size();
+		sim.events.clear();
+		if (done >= kWarmupTicks) allocs += (g_heapAllocs - before);
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+
+	const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	std::printf("%-10s ticks=%-7d events=%-5zu cleared=%d  %.3f ms  (%.0f ticks/ms)  heap allocs after warmup=%zu  scratch peak=%zuB\n",
+		name, done, events, (int)sim.cleared, ms, (ms > 0.0 ? done / ms : 0.0), allocs, sim.scratch.bytesPeak());
+}
+
+// 記録どおりに回す。記録時と結果（クリアの有無・tick 数・最後のプレイヤー位置）が一致すれば true
+template <class Sim>
+static bool RunReplay(const char* path, const InputTape& tape) {
+	Sim sim{ tape.seed };
+	sim.inputLatency = tape.latencySec();
+	size_t done = 0;
+
+	const auto t0 = std::chrono::steady_clock::now();
+	for (; done < tape.ticks.size() && !sim.cleared; ++done) {
+		sim.step(tape.at(done), SimTickDt);
+		sim.events.clear();
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+
+	// 位置は保存時に小数3桁へ丸めている
+	const double posErr = tape.hasFinal ? Max(Abs(sim.player.pos.x - tape.finalPos.x), Abs(sim.player.pos.y - tape.finalPos.y)) : 0.0;
+	const bool ok = (sim.cleared == tape.cleared) && (done == tape.ticks.size()) && (posErr < 0.01);
+	const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	const double realMs = done * SimTickDt * 1000.0;
+	std::printf("%s  %s  stage=%d ticks=%zu/%zu cleared=%d (recorded %d)  pos err=%.3f  %.3f ms  (x%.0f)\n",
+		(ok ? "ok  " : "FAIL"), path, (int)tape.stage, done, tape.ticks.size(),
+		(int)sim.cleared, (int)tape.cleared, posErr, ms, (ms > 0.0 ? realMs / ms : 0.0));
+	return ok;
+}
+
+// 粒のプールを満杯近くで回し、1フレーム（60fps）あたりの更新時間を出す
+static void RunParticles(const size_t count) {
+	constexpr int kTicks = 600;
+	ParticlePool pool{ count, ParticlePool::Params{ .gravity = 980.0f, .fade = 0.5f, .killY = 2000.0f, .minAlpha = 0.02f } };
+	SimRng rng{ 1 };
+	const auto spawn = [&](size_t) {
+		return ParticlePool::Spawn{ .pos = Vec2{ rng.uniform(0.0, 960.0), rng.uniform(0.0, 640.0) },
+			.vel = Vec2{ rng.uniform(-80.0, 80.0), rng.uniform(-400.0, 0.0) }, .size = 3.0, .shrink = 0.2 };
+	};
+
+	size_t updated = 0;
+	const auto t0 = std::chrono::steady_clock::now();
+	for (int i = 0; i < kTicks; ++i) {
+		pool.emitBurst(pool.capacity() - pool.size(), spawn);
+		updated += pool.size();
+		pool.update(1.0 / 60.0);
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+
+	const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	std::printf("%-10s count=%-7zu %.3f ms/frame  (%.2f ns/particle)\n",
+		"Particles", count, ms / kTicks, (updated ? ms * 1e6 / updated : 0.0));
+}
+
+// タイトルの輪だけを回す（RunBench からステージと同じ形で扱う）
+struct TitleBenchSim {
+	TitleRings rings;
+	double inputLatency = -1.0;
+	bool   cleared = false;
+	Array<SimEvent> events;
+
+	TitleBenchSim(uint64 seed, const SimLoad& load) : rings{ seed, load } {}
+	void step(const PlayerInput&, double dt) { rings.update(dt, Size{ 960, 640 }); }
+};
+
+// 1ステージぶんを frames フレーム回して JSON を1行出す。sims 個の sim（シード 1..sims）を同時に回し、
+// 各 sim の物の数は SimLoad::Scaled(stress)。tape があればその入力で回す（全 sim 同じ入力）
+template <class Sim>
+static void RunBench(const char* name, const int frames, const int stress, const int simCount, const InputTape* tape = nullptr) {
+	constexpr int kTicksPerFrame = 2;   // 60fps
+
+	const size_t heapBefore = g_heapBytes;
+	g_heapPeak = g_heapBytes;
+
+	const SimLoad load = SimLoad::Scaled(stress);
+	std::vector<std::unique_ptr<Sim>> sims;
+	sims.reserve(simCount);
+	for (int i = 0; i < simCount; ++i) {
+		sims.push_back(std::make_unique<Sim>(tape ? tape->seed : (uint64)(i + 1), load));
+		if (tape) sims.back()->inputLatency = tape->latencySec();
+	}
+	std::vector<double> frameUs;
+	frameUs.reserve(frames);
+
+	size_t events = 0, allocs = 0, maxAllocs = 0;
+	int tick = 0, done = 0;
+	for (; done < frames; ++done) {
+		bool any = false;
+		const size_t before = g_heapAllocs;
+		const auto t0 = std::chrono::steady_clock::now();
+		for (int k = 0; k < kTicksPerFrame; ++k, ++tick) {
+			const PlayerInput in = tape ? tape->at((size_t)tick) : ScriptedInput(tick);
+			for (auto& sim : sims) {
+				if (sim->cleared) continue;
+				sim->step(in, SimTickDt);
+				events += sim->events.size();
+				sim->events.clear();
+				any = true;
+			}
+		}
+		const auto t1 = std::chrono::steady_clock::now();
+		if (!any) break;   // 全部クリアした
+
+		frameUs.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+		const size_t n = g_heapAllocs - before;
+		allocs += n;
+		maxAllocs = std::max(maxAllocs, n);
+	}
+
+	std::vector<double> sorted = frameUs;
+	std::sort(sorted.begin(), sorted.end());
+	const auto pct = [&](const double q) { return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))]; };
+	double sum = 0.0;
+	for (const double us : frameUs) sum += us;
+	int cleared = 0;
+	for (const auto& sim : sims) cleared += sim->cleared;
+
+	std::printf("{\"stage\":\"%s\",\"frames\":%zu,\"stress\":%d,\"sims\":%d,\"input\":\"%s\","
+		"\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,"
+		"\"allocs_per_frame\":%.4f,\"max_allocs_frame\":%zu,\"heap_peak_bytes\":%zu,\"events\":%zu,\"cleared\":%d}\n",
+		name, frameUs.size(), stress, simCount, (tape ? "replay" : "scripted"),
+		(frameUs.empty() ? 0.0 : sum / frameUs.size()), pct(0.50), pct(0.99), (sorted.empty() ? 0.0 : sorted.back()),
+		(frameUs.empty() ? 0.0 : (double)allocs / frameUs.size()), maxAllocs, g_heapPeak - heapBefore, events, cleared);
+}
+
+// 密度一定のまま矩形数を増やし、1クエリあたりの時間をグリッドと全件走査で比較して CSV で出す
+static int RunBroadphaseBench() {
+	using Clock = std::chrono::steady_clock;
+	const auto usSince = [](const Clock::time_point t0) { return std::chrono::duration<double, std::micro>(Clock::now() - t0).count(); };
+
+	constexpr int kQueries = 4096;
+	SimRng rng{ 12345 };
+	int status = 0;
+
+	std::printf("colliders,grid_us_per_query,linear_us_per_query,candidates_per_query\n");
+	for (const int n : { 10, 100, 1000, 10000, 100000 }) {
+		const double side = Math::Sqrt((double)n) * 120.0;
+
+		Array<RectF> rects;
+		rects.reserve(n);
+		for (int i = 0; i < n; ++i) {
+			rects << RectF{ rng.uniform(0.0, side), rng.uniform(0.0, side), rng.uniform(16.0, 96.0), rng.uniform(8.0, 48.0) };
+		}
+		ColliderGrid grid;
+		for (const auto& r : rects) grid.insert(r);
+
+		Array<RectF> queries;
+		queries.reserve(kQueries);
+		for (int i = 0; i < kQueries; ++i) {
+			queries << RectF{ rng.uniform(0.0, side), rng.uniform(0.0, side), 28, 36 };
+		}
+
+		size_t hitsGrid = 0, candidates = 0;
+		const auto t0 = Clock::now();
+		for (const auto& q : queries) {
+			const auto& found = grid.query(q);
+			candidates += found.size();
+			for (const auto h : found) hitsGrid += q.intersects(grid.rect(h));
+		}
+		const double gridUs = usSince(t0) / kQueries;
+
+		size_t hitsLinear = 0;
+		const auto t1 = Clock::now();
+		for (const auto& q : queries) {
+			for (const auto& r : rects) hitsLinear += q.intersects(r);
+		}
+		const double linearUs = usSince(t1) / kQueries;
+
+		if (hitsGrid != hitsLinear) {
+			std::printf("# mismatch at n=%d: grid=%zu linear=%zu\n", n, hitsGrid, hitsLinear);
+			status = 1;
+		}
+		std::printf("%d,%.3f,%.3f,%.2f\n", n, gridUs, linearUs, (double)candidates / kQueries);
+	}
+	return status;
+}
+
+static bool RunReplayFile(const char* path) {
+	InputTape tape;
+	if (!tape.load(path)) {
+		std::printf("FAIL  %s  (読み込めません)\n", path);
+		return false;
+	}
+	switch (tape.stage) {
+	case Stage1Sim::StageId:    return RunReplay<Stage1Sim>(path, tape);
+	case Stage2Sim::StageId:    return RunReplay<Stage2Sim>(path, tape);
+	case Stage3Sim::StageId:    return RunReplay<Stage3Sim>(path, tape);
+	case Stage4Sim::StageId:    return RunReplay<Stage4Sim>(path, tape);
+	case StageLastSim::StageId: return RunReplay<StageLastSim>(path, tape);
+	default:
+		std::printf("FAIL  %s  (stage=%d は不明)\n", path, (int)tape.stage);
+		return false;
+	}
+}
+
+//============================= 拍の時計の確認 =============================
+// 実機の音の代わりに、経過時間どおりに進み、ミキサーのバッファ単位でしか位置が更新されないループ再生を作って BeatClock を回す
+
+struct FakeLoopAudio {
+	static constexpr uint32 kRate = 48000;
+	static constexpr int64 kBuffer = 512;   // 再生位置が進む単位
+
+	// ずれの許容：ミキサーのバッファ1つぶん（再生位置はこれより細かくは分からない）
+	static constexpr double kBufferUs = 1e6 * kBuffer / kRate;
+
+	int64  length = 1;
+	double playedSec = 0.0;   // 再生位置（ループの頭から、巻き戻さずに数えた秒）
+
+	int64 posSample() const {
+		const int64 played = (int64)(playedSec * kRate) / kBuffer * kBuffer;
+		return played % length;
+	}
+	void seekSamples(const size_t pos) { playedSec = (double)pos / kRate; }
+};
+
+static void PrintOffsetStats(const char* label, const OffsetStats& e) {
+	std::printf("  %s mean %6.0f us  jitter %5.0f us  max %6.0f us", label, e.mean(), e.jitter(), e.max);
+}
+
+// フレームの途中で長く止まっても（ウィンドウのドラッグや読み込み）、拍の時計が音の位置から外れないこと。
+// フレームの長さは ±2ms 揺らし、音の出力は drift（割合）だけ速く・遅く進める（サウンドデバイスの時計のずれ）
+static bool CheckBeatClockStall(const double stallSec, const double drift) {
+	const Stage2Sim sim{ 1 };
+	FakeLoopAudio audio{ .length = (int64)Math::Round(sim.period() * FakeLoopAudio::kRate) };
+	BeatClock clock;
+	constexpr double kStart = 0.25;   // 鳴らし始めた拍の時刻
+	clock.start(kStart, FakeLoopAudio::kRate, (size_t)audio.length);
+
+	// 鼓動の時刻（時計）と、ループの本当のサンプル位置から出した時刻とのずれ
+	OffsetStats onset;
+	SimRng rng{ 3 };
+	for (int frame = 0; frame < 60 * 60; ++frame) {
+		const double dt = (frame == 60) ? stallSec : (1.0 / 60.0 + rng.uniform(-0.002, 0.002));
+		audio.playedSec += dt * (1.0 + drift);
+		clock.update(dt, audio.posSample());
+		onset.add((clock.time() - (kStart + audio.playedSec)) * 1e6);
+	}
+
+	const bool ok = (onset.max < FakeLoopAudio::kBufferUs);
+	std::printf("%s  beat clock  stall %.2f s  drift %+4.0f ppm ", (ok ? "ok  " : "FAIL"), stallSec, drift * 1e6);
+	PrintOffsetStats("onset", onset);
+	std::printf("\n");
+	return ok;
+}
+
+// 処理落ちで tick を捨てたフレームのあとも、判定（sim の時刻）と描画の時計・鳴っている音がそろっていること。
+// Stage2 の stepFixed / onTicksDropped / BeatTrack::update と同じ順で回す。resync = false は合わせ直さない場合
+static bool CheckBeatHitch(const double hitchSec, const bool resync) {
+	Stage2Sim sim{ 1 };
+	FakeLoopAudio audio{ .length = (int64)Math::Round(sim.period() * FakeLoopAudio::kRate) };
+	BeatClock clock;
+	FixedStepper stepper;
+	bool started = false;
+	double startTime = 0.0;
+	const double p = sim.period();
+	const auto wrap = [p](const double d) { return d - p * Math::Round(d / p); };
+
+	OffsetStats heard, visual;   // 判定の時刻に対する、鳴っている音・時計のずれ
+	double dropped = 0.0;
+	int32 mismatches = 0;   // 聞こえた拍に合わせて押したときと、判定が食い違うフレーム
+	for (int frame = 0; frame < 360; ++frame) {
+		const double dt = (frame == 120) ? hitchSec : (1.0 / 60.0);
+		if (started) audio.playedSec += dt;
+
+		bool skip = false;   // BeatTrack::fresh と同じ
+		stepper.beginFrame(dt);
+		while (stepper.due()) {
+			sim.step(PlayerInput{}, SimTickDt);
+			stepper.consume();
+			for (const auto e : sim.events) {
+				if (e != SimEvent::StartHeartbeat) continue;
+				startTime = sim.beatTime() + stepper.accum;   // 鳴り始めるのは今（Stage2::onSimEvent と同じ）
+				clock.start(startTime, FakeLoopAudio::kRate, (size_t)audio.length);
+				started = true;
+				skip = true;
+			}
+			sim.events.clear();
+		}
+		if (const double d = stepper.dropOverflow(); d > 0.0) {
+			dropped += d;
+			if (resync && started) {
+				audio.seekSamples(clock.positionAt(sim.beatTime()));
+				clock.set(sim.beatTime());
+				skip = true;
+			}
+		}
+		if (!started) continue;
+		clock.update(skip ? 0.0 : dt, audio.posSample());
+
+		const double judge = sim.beatTime() + stepper.accum;           // renderTime() - t0
+		const double d = wrap(startTime + audio.playedSec - judge);     // 鳴っている音（サンプル位置）とのずれ
+		heard.add(d * 1e6);
+		visual.add(wrap(clock.time() - judge) * 1e6);
+		if (Abs(d) * 1e6 < FakeLoopAudio::kBufferUs) continue;
+		mismatches += (sim.isOnBeatAt(judge) != sim.isOnBeatAt(judge + d));
+	}
+
+	const bool agree = (heard.max < FakeLoopAudio::kBufferUs && visual.max < FakeLoopAudio::kBufferUs && mismatches == 0);
+	const bool ok = (dropped > 0.0) && (resync == agree);
+	std::printf("%s  beat hitch  %.2f s %s dropped %4.0f ms", (ok ? "ok  " : "FAIL"), hitchSec, (resync ? "resync   " : "no resync"), dropped * 1000.0);
+	PrintOffsetStats("audio", heard);
+	PrintOffsetStats("clock", visual);
+	std::printf("  judge mismatch %d\n", mismatches);
+	return ok;
+}
+
+// 許容はどれもミキサーのバッファ1つぶん（48kHz・512 サンプルで約 10.7ms）
+static int RunBeatChecks() {
+	bool ok = true;
+	for (const double stall : { 0.5, 1.0, 2.5, 7.0 }) {
+		for (const double drift : { 0.0, 300e-6, -300e-6 }) ok = (CheckBeatClockStall(stall, drift) && ok);
+	}
+	for (const double hitch : { 0.2, 0.5, 1.3 }) {
+		ok = (CheckBeatHitch(hitch, false) && ok);   // 合わせ直さなければ音と判定がずれる（確認の前提）
+		ok = (CheckBeatHitch(hitch, true) && ok);
+	}
+	return (ok ? 0 : 1);
+}
+
+//============================= マイクロベンチマーク =============================
+// 関数1つを回数を増やしながら回し、合計が kMinNs を超えたところの1回あたりの時間を出す。
+// 各ケースは iters 回ぶんの計測時間（準備は含めない）を ns で返す
+
+// 結果を捨てられて呼び出しごと消されないように、値を使ったことにする
+template <class T>
+static void KeepAlive(const T& v) { asm volatile("" : : "r,m"(v) : "memory"); }
+
+using MicroClock = std::chrono::steady_clock;
+
+static double MicroElapsedNs(const MicroClock::time_point t0) {
+	return std::chrono::duration<double, std::nano>(MicroClock::now() - t0).count();
+}
+
+// 密度一定（BenchBroadphase と同じ）で n 個の足場を置き、その中で1 tick ずつ動かす
+static double MicroPlayerUpdate(const int64 iters, const int n) {
+	SimRng rng{ 12345 };
+	const double side = Math::Sqrt((double)n) * 120.0;
+	ColliderGrid grid;
+	for (int i = 0; i < n; ++i) {
+		grid.insert(RectF{ rng.uniform(0.0, side), rng.uniform(0.0, side), rng.uniform(16.0, 96.0), rng.uniform(8.0, 48.0) });
+	}
+	// 開始位置と入力を散らしておき、毎回どれかから1 tick 進める（落ち続けて足場の外へ出ないように）
+	constexpr size_t kStarts = 1024;
+	Array<Vec2> starts(kStarts);
+	Array<PlayerInput> inputs(kStarts);
+	for (size_t i = 0; i < kStarts; ++i) {
+		starts[i] = Vec2{ rng.uniform(0.0, side), rng.uniform(0.0, side) };
+		inputs[i] = ScriptedInput((int)(i * 37));
+	}
+	Player player;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		const size_t k = (size_t)i & (kStarts - 1);
+		player.snapTo(starts[k]);
+		player.vel = Vec2{ 0, 200 };
+		KeepAlive(player.update(grid, inputs[k], SimTickDt));
+	}
+	return MicroElapsedNs(t0);
+}
+
+static double MicroLandedFromJumpOn(const int64 iters, int) {
+	Stage3Sim sim{ 1 };
+	const RectF lead{ 200, 560, 240, 8 };
+	constexpr size_t kCases = 256;
+	Array<Player> cases(kCases, sim.player);
+	SimRng rng{ 7 };
+	for (auto& p : cases) {
+		p.prevPos = Vec2{ rng.uniform(150.0, 450.0), rng.uniform(480.0, 540.0) };
+		p.pos = p.prevPos + Vec2{ 0, rng.uniform(-4.0, 12.0) };
+		p.vel = Vec2{ 0, rng.uniform(-200.0, 600.0) };
+	}
+	size_t hits = 0;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		sim.player = cases[(size_t)i & (kCases - 1)];
+		hits += sim.landedFromJumpOn(lead);
+		KeepAlive(hits);
+	}
+	return MicroElapsedNs(t0);
+}
+
+static double MicroProjectedRect(const int64 iters, int) {
+	const Stage4Sim sim{ 1 };
+	Stage4Sim::DepthCar car;
+	car.spawnFar();
+	const double y0 = car.y, span = RoadProjection::roadYBottom + 220.0 - y0;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		car.y = y0 + span * (double)(i & 1023) / 1024.0;
+		KeepAlive(car.projectedRect(sim.road));
+	}
+	return MicroElapsedNs(t0);
+}
+
+static double MicroEdgeLeftX(const int64 iters, int) {
+	const Stage4Sim sim{ 1 };
+	const double y0 = RoadProjection::roadYTop, span = RoadProjection::roadYBottom - y0;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		KeepAlive(sim.road.edgeLeftX(y0 + span * (double)(i & 1023) / 1024.0));
+	}
+	return MicroElapsedNs(t0);
+}
+
+static double MicroBeatPhase(const int64 iters, int) {
+	Stage2Sim sim{ 1 };
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		sim.simTime = (double)(i & 0xFFFF) * SimTickDt;
+		KeepAlive(sim.phase());
+	}
+	return MicroElapsedNs(t0);
+}
+
+// tick ごとの拍の判定：その tick の位相と、押した時刻（tick 内の 1/16 単位まで）が拍に合っているか
+static double MicroBeatJudge(const int64 iters, int) {
+	Stage2Sim sim{ 1 };
+	size_t hits = 0;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		sim.simTime = (double)(i & 0xFFFF) * SimTickDt;
+		const double pressedAt = sim.beatTime() + (double)(i & 15) * (SimTickDt / 16.0);
+		hits += (sim.phase() < 0.5) + sim.isOnBeatAt(pressedAt);
+		KeepAlive(hits);
+	}
+	return MicroElapsedNs(t0);
+}
+
+static double MicroIsOnBeatAt(const int64 iters, int) {
+	const Stage2Sim sim{ 1 };
+	size_t hits = 0;
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		hits += sim.isOnBeatAt((double)(i & 0xFFFF) * (1.0 / 1000.0));
+		KeepAlive(hits);
 	}
+	return MicroElapsedNs(t0);
 }
+
+// n 枚の足場（ステージの作り方と同じく sceneSize 内に配置）からグリッドを作る
+static double MicroMakeLevelColliders(const int64 iters, const int n) {
+	const Size sceneSize{ 960, 640 };
+	SimRng rng{ 3 };
+	Array<RectF> platforms;
+	platforms.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		platforms << RectF{ rng.uniform(0.0, 900.0), rng.uniform(0.0, 600.0), rng.uniform(40.0, 240.0), 14 };
+	}
+	const auto t0 = MicroClock::now();
+	for (int64 i = 0; i < iters; ++i) {
+		const ColliderGrid cols = MakeLevelColliders(sceneSize, platforms);
+		KeepAlive(cols.size());
+	}
+	return MicroElapsedNs(t0);
+}
+
+struct MicroCase {
+	const char* name;
+	double (*run)(int64 iters, int arg);
+	int arg;            // 名前の後ろに /arg を付ける（負なら付けない）
+};
+
+static constexpr MicroCase kMicroCases[] = {
+	{ "Player::update", MicroPlayerUpdate, 1 },
+	{ "Player::update", MicroPlayerUpdate, 10 },
+	{ "Player::update", MicroPlayerUpdate, 100 },
+	{ "Player::update", MicroPlayerUpdate, 1000 },
+	{ "Player::update", MicroPlayerUpdate, 10000 },
+	{ "Player::update", MicroPlayerUpdate, 100000 },
+	{ "Stage3Sim::landedFromJumpOn", MicroLandedFromJumpOn, -1 },
+	{ "DepthCar::projectedRect", MicroProjectedRect, -1 },
+	{ "RoadProjection::edgeLeftX", MicroEdgeLeftX, -1 },
+	{ "Stage2Sim::phase", MicroBeatPhase, -1 },
+	{ "Stage2Sim::judge (phase + isOnBeatAt)", MicroBeatJudge, -1 },
+	{ "Stage2Sim::isOnBeatAt", MicroIsOnBeatAt, -1 },
+	{ "MakeLevelColliders", MicroMakeLevelColliders, 4 },
+	{ "MakeLevelColliders", MicroMakeLevelColliders, 64 },
+	{ "MakeLevelColliders", MicroMakeLevelColliders, 1024 },
+};
+
+static int RunMicroMain(const char* filter) {
+	constexpr double kMinNs = 0.25e9;
+
+	std::printf("%-40s %14s %14s\n", "Benchmark", "Time", "Iterations");
+	for (const auto& c : kMicroCases) {
+		char name[64];
+		if (c.arg >= 0) std::snprintf(name, sizeof(name), "%s/%d", c.name, c.arg);
+		else std::snprintf(name, sizeof(name), "%s", c.name);
+		if (filter && !std::strstr(name, filter)) continue;
+
+		// 短すぎて測れないうちは回数を増やす（次の回数は今の結果から見積もる）
+		int64 iters = 1;
+		double ns = c.run(iters, c.arg);
+		while (ns < kMinNs) {
+			const double grow = (ns > 0.0) ? (kMinNs * 1.4 / ns) : 100.0;
+			iters = (int64)((double)iters * Clamp(grow, 2.0, 100.0));
+			ns = c.run(iters, c.arg);
+		}
+		std::printf("%-40s %11.2f ns %14lld\n", name, ns / (double)iters, (long long)iters);
+	}
+	return 0;
+}
+
+static int RunBenchMain(int argc, char** argv) {
+	int frames = 60 * 600;   // 既定はゲーム内10分
+	int stress = 1;
+	int simCount = 1;
+	int replayFrom = argc;
+	for (int i = 2; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--stress") == 0 && i + 1 < argc) stress = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--sims") == 0 && i + 1 < argc) simCount = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--replay") == 0) { replayFrom = i + 1; break; }
+		else frames = std::max(1, std::atoi(argv[i]));
+	}
+
+	if (replayFrom == argc) {
+		RunBench<TitleBenchSim>("Title", frames, stress, simCount);
+		RunBench<Stage1Sim>("Stage1", frames, stress, simCount);
+		RunBench<Stage2Sim>("Stage2", frames, stress, simCount);
+		RunBench<Stage3Sim>("Stage3", frames, stress, simCount);
+		RunBench<Stage4Sim>("Stage4", frames, stress, simCount);
+		RunBench<StageLastSim>("StageLast", frames, stress, simCount);
+		return 0;
+	}
+
+	int status = 0;
+	for (int i = replayFrom; i < argc; ++i) {
+		InputTape tape;
+		if (!tape.load(argv[i])) { std::fprintf(stderr, "cannot read %s\n", argv[i]); status = 1; continue; }
+		const int n = std::min(frames, (int)(tape.ticks.size() + 1) / 2);
+		switch (tape.stage) {
+		case Stage1Sim::StageId:    RunBench<Stage1Sim>("Stage1", n, stress, simCount, &tape); break;
+		case Stage2Sim::StageId:    RunBench<Stage2Sim>("Stage2", n, stress, simCount, &tape); break;
+		case Stage3Sim::StageId:    RunBench<Stage3Sim>("Stage3", n, stress, simCount, &tape); break;
+		case Stage4Sim::StageId:    RunBench<Stage4Sim>("Stage4", n, stress, simCount, &tape); break;
+		case StageLastSim::StageId: RunBench<StageLastSim>("StageLast", n, stress, simCount, &tape); break;
+		default: std::fprintf(stderr, "%s: unknown stage %d\n", argv[i], (int)tape.stage); status = 1; break;
+		}
+	}
+	return status;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+		return RunBenchMain(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--bench-broadphase") == 0) {
+		return RunBroadphaseBench();
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--check-beat") == 0) {
+		return RunBeatChecks();
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--micro") == 0) {
+		return RunMicroMain((argc > 2) ? argv[2] : nullptr);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--replay") == 0) {
+		bool allOk = true;
+		for (int i = 2; i < argc; ++i) allOk = (RunReplayFile(argv[i]) && allOk);
+		return (allOk ? 0 : 1);
+	}
+
+	const int ticks = (argc > 1) ? std::atoi(argv[1]) : 120 * 600;   // 既定はゲーム内10分
+
+	RunHeadless<Stage1Sim>("Stage1", ticks);
+	RunHeadless<Stage2Sim>("Stage2", ticks);
+	RunHeadless<Stage3Sim>("Stage3", ticks);
+	RunHeadless<Stage4Sim>("Stage4", ticks);
+	RunHeadless<StageLastSim>("StageLast", ticks);
+	RunParticles(50000);
+	return 0;
+}
+
+# endif // SINLAND_HEADLESS